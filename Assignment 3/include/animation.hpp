@@ -10,9 +10,11 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <iostream>
 #include <algorithm>
 #include <cmath>     
+#include "text_writer.hpp"
 
 // Represents one camera state
 struct CameraKey {
@@ -29,10 +31,10 @@ struct SceneKey {
     float handPitch, handYaw, handRoll;
     float gripperOpen;
 
-    // Light states (0.0f for off, 1.0f for on)
-    float light0On;
-    float light1On;
-    float toyLightOn;
+    // Light states, one per entry of the scene light list (0.0f for off,
+    // 1.0f for on). The first three (L0, L1, toy light) keep their columns in
+    // scene.key; any further lights follow carYaw as a count and the values.
+    std::vector<float> lightOn;
 
     // Other object transforms (example for car)
     glm::vec3 carPos;
@@ -45,13 +47,13 @@ struct AnimationSystem {
     std::vector<SceneKey> sceneKeys;
 
     // Camera Keyframes
+    // (floats in shortest round-trip form, see text_writer.hpp)
     bool saveCameraKeys(const std::string &filename) const {
-        std::ofstream fout(filename);
-        if (!fout) return false;
+        text_writer_t fout;
         for (auto &k : cameraKeys) {
             fout << k.t << " "<< k.eye.x << " " << k.eye.y << " " << k.eye.z << " "<< k.lookAt.x << " " << k.lookAt.y << " " << k.lookAt.z << " "<< k.up.x << " " << k.up.y << " " << k.up.z << "\n";
         }
-        return true;
+        return fout.write(filename);
     }
 
     bool loadCameraKeys(const std::string &filename) {
@@ -68,36 +70,50 @@ struct AnimationSystem {
 
     // Scene Keyframes
     bool saveSceneKeys(const std::string &filename) const {
-        std::ofstream fout(filename);
-        if (!fout) return false;
+        text_writer_t fout;
         for (auto &k : sceneKeys) {
+            auto on = [&](size_t i) { return i < k.lightOn.size() ? k.lightOn[i] : 1.0f; };
             fout << k.t << " "
                  << k.lowerArmPitch << " " << k.lowerArmYaw << " "
                  << k.upperArmPitch << " " << k.upperArmYaw << " "
                  << k.handPitch << " " << k.handYaw << " "
                  << k.handRoll << " "
                  << k.gripperOpen << " "
-                 << k.light0On << " " << k.light1On << " " << k.toyLightOn << " "
+                 << on(0) << " " << on(1) << " " << on(2) << " "
                  << k.carPos.x << " " << k.carPos.y << " " << k.carPos.z << " "
-                 << k.carYaw << "\n";
+                 << k.carYaw;
+            if (k.lightOn.size() > 3) {
+                fout << " " << (k.lightOn.size() - 3);
+                for (size_t i = 3; i < k.lightOn.size(); ++i) fout << " " << k.lightOn[i];
+            }
+            fout << "\n";
         }
-        return true;
+        return fout.write(filename);
     }
 
     bool loadSceneKeys(const std::string &filename) {
         std::ifstream fin(filename);
         if (!fin) return false;
         sceneKeys.clear();
-        SceneKey k;
-        while (fin >> k.t
-                 >> k.lowerArmPitch >> k.lowerArmYaw
-                 >> k.upperArmPitch >> k.upperArmYaw
-                 >> k.handPitch >> k.handYaw
-                 >> k.handRoll
-                 >> k.gripperOpen
-                 >> k.light0On >> k.light1On >> k.toyLightOn
-                 >> k.carPos.x >> k.carPos.y >> k.carPos.z
-                 >> k.carYaw) {
+        std::string line;
+        while (std::getline(fin, line)) {
+            std::istringstream in(line);
+            SceneKey k;
+            k.lightOn.resize(3);
+            if (!(in >> k.t
+                     >> k.lowerArmPitch >> k.lowerArmYaw
+                     >> k.upperArmPitch >> k.upperArmYaw
+                     >> k.handPitch >> k.handYaw
+                     >> k.handRoll
+                     >> k.gripperOpen
+                     >> k.lightOn[0] >> k.lightOn[1] >> k.lightOn[2]
+                     >> k.carPos.x >> k.carPos.y >> k.carPos.z
+                     >> k.carYaw)) continue; // blank or short line
+            size_t extra = 0;
+            if (in >> extra) {
+                k.lightOn.resize(3 + extra, 1.0f);
+                for (size_t i = 0; i < extra; ++i) in >> k.lightOn[3 + i];
+            }
             sceneKeys.push_back(k);
         }
         std::cout << "Loaded " << sceneKeys.size() << " scene keys from " << filename << "\n";
@@ -242,9 +258,7 @@ public:
             state.scene.carPos = lerp(s0.carPos, s1.carPos, alpha);
             state.scene.carYaw = lerp(s0.carYaw, s1.carYaw, alpha);
 
-            state.scene.light0On   = s0.light0On;
-            state.scene.light1On   = s0.light1On;
-            state.scene.toyLightOn = s0.toyLightOn;
+            state.scene.lightOn = s0.lightOn;
         }
 
         return state;
@@ -0,0 +1,34 @@
+// -----------------------------------------------------------------------------
+// baked_mesh.hpp : Merged geometry of a static subtree (one per material).
+// Vertices are in the frame of the subtree root with node transforms applied,
+// so the whole group draws with the root's world matrix in one call.
+// -----------------------------------------------------------------------------
+#pragma once
+#include "shape.hpp"
+#include <string>
+
+class baked_mesh_t : public shape_t {
+public:
+    baked_mesh_t(): shape_t(0) {}
+    // Append src transformed by m (normals by the inverse transpose)
+    void append(const shape_t &src, const glm::mat4 &m){
+        glm::mat3 nm = glm::transpose(glm::inverse(glm::mat3(m)));
+        GLuint base = (GLuint)vertices.size();
+        for(size_t k = 0; k < src.vertices.size(); k++){
+            vertices.push_back(m * src.vertices[k]);
+            normals.push_back(k < src.normals.size() ? glm::normalize(nm * src.normals[k]) : glm::vec3(0,1,0));
+            texcoords.push_back(k < src.texcoords.size() ? src.texcoords[k] : glm::vec2(0.0f));
+            bounds.grow(glm::vec3(vertices.back()));
+        }
+        for(GLuint i : src.indices) indices.push_back(base + i);
+    }
+    // Upload once all parts are appended
+    void finish(){ setup_buffers(); }
+
+    virtual void draw() override { draw_elements(); }
+    virtual std::string name() const override { return "baked"; }
+    virtual aabb_t local_bounds() const override { return bounds; }
+
+private:
+    aabb_t bounds;
+};
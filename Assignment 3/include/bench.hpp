@@ -0,0 +1,22 @@
+// -----------------------------------------------------------------------------
+// bench.hpp
+// Timing runs behind ./model --bench <name> [args] (hidden window, run from the
+// repo root like the app):
+//   kernels   world-frame propagation (per-node mul vs batched propagate) and
+//             world bounds with each matrix kernel set, on every .mod in models/
+//   query     get_world_frame_of (ancestor walk) vs the old full-tree search,
+//             on a generated 100k-node model (or the count given)
+//   shaders   frame time per shader permutation (material x light mode), with
+//             and without rasterization, room + robot + 500 spheres (or the
+//             count given)
+//   lights    frame time and cluster build with 8, 64 and 512 scattered lights
+//             (or the counts given)
+//   meshcache startup mesh work with the disk cache off, cold and warm
+//   parse     text parser MB/s and nodes/s on generated 10k/100k/1M-node models
+//   load      .mod vs .modb load time of one generated model (1M nodes, or
+//             the count given)
+// -----------------------------------------------------------------------------
+#pragma once
+
+// argv[0] is the bench name; returns the process exit code
+int run_bench(int argc, char** argv);
@@ -0,0 +1,60 @@
+// -----------------------------------------------------------------------------
+// bounds.hpp
+// Axis-aligned boxes and bounding spheres. Shapes report closed-form local
+// bounds (see shape_t::local_bounds) so hierarchy bounds cost O(nodes)
+// instead of O(vertices). frustum_t tests boxes against a view-projection.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <limits>
+#include <glm/glm.hpp>
+
+struct aabb_t {
+    glm::vec3 lo = glm::vec3( std::numeric_limits<float>::infinity());
+    glm::vec3 hi = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    aabb_t() = default;
+    aabb_t(const glm::vec3 &l, const glm::vec3 &h): lo(l), hi(h) {}
+
+    bool empty() const { return lo.x > hi.x || lo.y > hi.y || lo.z > hi.z; }
+    glm::vec3 center() const { return 0.5f * (lo + hi); }
+    glm::vec3 half() const { return 0.5f * (hi - lo); }
+    void grow(const glm::vec3 &p){ lo = glm::min(lo, p); hi = glm::max(hi, p); }
+    void grow(const aabb_t &b){ if(!b.empty()){ lo = glm::min(lo, b.lo); hi = glm::max(hi, b.hi); } }
+
+    // Tight box around the 8 transformed corners of this box (affine m),
+    // computed as center + |M| * half instead of transforming each corner.
+    aabb_t transformed(const glm::mat4 &m) const {
+        if(empty()) return aabb_t();
+        glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+        glm::vec3 h = half();
+        glm::vec3 e = glm::abs(glm::vec3(m[0])) * h.x + glm::abs(glm::vec3(m[1])) * h.y + glm::abs(glm::vec3(m[2])) * h.z;
+        return aabb_t(c - e, c + e);
+    }
+};
+
+// Six clip planes (ax+by+cz+d >= 0 inside) extracted from a view-projection matrix
+struct frustum_t {
+    glm::vec4 planes[6];
+
+    explicit frustum_t(const glm::mat4 &vp){
+        glm::mat4 r = glm::transpose(vp); // r[i] = row i of vp
+        planes[0] = r[3] + r[0]; planes[1] = r[3] - r[0]; // left, right
+        planes[2] = r[3] + r[1]; planes[3] = r[3] - r[1]; // bottom, top
+        planes[4] = r[3] + r[2]; planes[5] = r[3] - r[2]; // near, far
+    }
+    // Conservative: false only if the box is fully outside one plane
+    bool intersects(const aabb_t &b) const {
+        if(b.empty()) return false;
+        glm::vec3 c = b.center(), h = b.half();
+        for(const auto &p : planes){
+            glm::vec3 n(p);
+            if(glm::dot(n, c) + p.w < -glm::dot(glm::abs(n), h)) return false;
+        }
+        return true;
+    }
+};
+
+struct bsphere_t {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
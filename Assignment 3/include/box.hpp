@@ -7,6 +7,12 @@ class box_t : public shape_t {
 public:
     glm::vec3 half;
     box_t(unsigned int lev=0, glm::vec3 half_extents = glm::vec3(0.5f));
+    // Arrays from an earlier tessellation with the same parameters
+    box_t(unsigned int lev, glm::vec3 half_extents, mesh_data_t &&prebuilt);
+    // Tessellation only (no GL calls, safe on any thread)
+    static mesh_data_t build(unsigned int lev, glm::vec3 half_extents);
     virtual void draw() override;
     virtual std::string name() const override { return "box"; }
+    virtual aabb_t local_bounds() const override { return aabb_t(-half, half); }
+    virtual bsphere_t local_sphere() const override { return { glm::vec3(0.0f), glm::length(half) }; }
 };
@@ -1,5 +1,5 @@
 // -----------------------------------------------------------------------------
-// cone.hpp : Simple cone (apex + base fan) colored per triangle.
+// cone.hpp : Simple cone (apex + base fan) sharing one rim ring.
 // -----------------------------------------------------------------------------
 #pragma once
 #include "shape.hpp"
@@ -7,6 +7,12 @@ class cone_t: public shape_t {
 public:
     float radius, height;
     cone_t(unsigned int lev=1, float r=0.4f, float h=1.0f);
+    // Arrays from an earlier tessellation with the same parameters
+    cone_t(unsigned int lev, float r, float h, mesh_data_t &&prebuilt);
+    // Tessellation only (no GL calls, safe on any thread)
+    static mesh_data_t build(unsigned int lev, float r, float h);
     virtual void draw() override;
     virtual std::string name() const override { return "cone"; }
+    virtual aabb_t local_bounds() const override { return aabb_t(glm::vec3(-radius, -0.5f*height, -radius), glm::vec3(radius, 0.5f*height, radius)); }
+    virtual bsphere_t local_sphere() const override { return { glm::vec3(0.0f), glm::length(glm::vec2(radius, 0.5f*height)) }; }
 };
@@ -0,0 +1,40 @@
+// -----------------------------------------------------------------------------
+// frame_uniforms.hpp
+// Per-frame constants (camera, light cluster grid) in one uniform block, updated
+// with a single buffer upload instead of a glUniform call per value.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+
+// std140 layout of `uniform Frame` in lighting.glsl
+struct frame_block_t {
+    glm::mat4 viewProj = glm::mat4(1.0f);
+    glm::vec4 clusterDepth = glm::vec4(0.0f); // x = near, y = slices / log(far/near)
+    GLint clusterDims[4] = {};                // tiles x, tiles y, slices, active lights (global mode: unbounded only)
+};
+
+class frame_uniforms_t {
+public:
+    static const GLuint BINDING = 0;
+
+    // Route the program's Frame block to our binding point (once per program)
+    static void attach(GLuint prog){
+        GLuint idx = glGetUniformBlockIndex(prog, "Frame");
+        if(idx != GL_INVALID_INDEX) glUniformBlockBinding(prog, idx, BINDING);
+    }
+    void upload(const frame_block_t &f){
+        if(!ubo){
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(frame_block_t), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame_block_t), &f);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    GLuint ubo = 0;
+};
@@ -0,0 +1,88 @@
+// -----------------------------------------------------------------------------
+// geometry_cache.hpp
+// Shares tessellated primitives between nodes. Meshes are keyed by shape type,
+// tessellation level and dimensions (color is per-node material state); nodes
+// hold a shared_ptr and the cache only keeps weak references, so a mesh (and
+// its VAO/VBOs) is released as soon as the last node using it goes away.
+// Tessellated arrays are also kept on disk (one file per key), so later
+// launches read them back instead of generating them.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glm/glm.hpp>
+#include "shape.hpp"
+
+struct geometry_key_t {
+    ShapeType type;
+    unsigned int level;
+    glm::vec3 dims;   // sphere: (r,0,0), cylinder/cone: (r,h,0), box: half extents
+    bool operator<(const geometry_key_t &o) const;
+};
+
+// Part of every disk cache file name: bump when a primitive's tessellation
+// changes so files written by the old generator miss
+static const uint32_t MESH_GENERATOR_VERSION = 1;
+
+// Mesh arrays as stored in .modb blobs and the disk cache: vertices (vec4),
+// normals (vec3), texcoords (vec2), indices (uint32), padded to 8 bytes
+uint64_t mesh_blob_bytes(uint32_t vertexCount, uint32_t indexCount);
+void write_mesh_blob(FILE* f, const shape_t &s);
+// Copy the arrays out of p (false if an index is out of range)
+bool read_mesh_blob(const char* p, uint32_t vertexCount, uint32_t indexCount, mesh_data_t &out);
+
+class geometry_cache_t {
+public:
+    static geometry_cache_t& instance();
+
+    std::shared_ptr<shape_t> sphere(unsigned int lev, float r);
+    std::shared_ptr<shape_t> cylinder(unsigned int lev, float r, float h);
+    std::shared_ptr<shape_t> cone(unsigned int lev, float r, float h);
+    std::shared_ptr<shape_t> box(unsigned int lev, const glm::vec3 &half);
+    // Default-sized primitive by .mod type name ("sphere", "box", ...); nullptr if unknown
+    std::shared_ptr<shape_t> by_name(std::string_view type, unsigned int lev);
+    // Key by_name() would use; false if the type is unknown
+    static bool name_key(std::string_view type, unsigned int lev, geometry_key_t &key);
+    // Mesh for key built from prebuilt arrays, or the live mesh if there is one.
+    // Not registered: later requests for key still get the generator's mesh.
+    std::shared_ptr<shape_t> adopt(const geometry_key_t &key, mesh_data_t &&prebuilt);
+    // One mesh per key. The missing ones are read from disk or tessellated on
+    // worker threads (one per core), then uploaded here in a single batch.
+    std::vector<std::shared_ptr<shape_t>> acquire_all(const std::vector<geometry_key_t> &keys);
+    // Count one more user of s as a hit: batch loaders acquire each key once
+    // and hand the mesh to every node that uses it
+    void count_hit(const shape_t &s){ hits++; bytes_saved += s.gpu_bytes(); }
+
+    // Directory for tessellated meshes ("" disables the disk cache)
+    void set_disk_directory(const std::string &d){ diskDir = d; diskDirMade = false; }
+
+    // Statistics
+    size_t hits = 0;          // requests served by an existing mesh
+    size_t misses = 0;        // requests that had to tessellate (or read from disk) + upload
+    size_t disk_loads = 0;    // misses served by the disk cache
+    size_t disk_saves = 0;    // meshes written to the disk cache
+    double build_ms = 0.0;    // time spent creating meshes on misses (wall clock)
+    size_t bytes_saved = 0;   // GPU vertex bytes not allocated thanks to hits
+    size_t live_meshes() const;
+    void print_stats() const;
+
+private:
+    enum source_t { ADOPTED, BUILT, BUILT_SAVED, FROM_DISK };
+    geometry_cache_t() = default;
+    std::shared_ptr<shape_t> acquire(const geometry_key_t &key, mesh_data_t *prebuilt = nullptr);
+    std::shared_ptr<shape_t> live(const geometry_key_t &key);
+    source_t prepare(const geometry_key_t &key, mesh_data_t &out) const;
+    std::shared_ptr<shape_t> upload(const geometry_key_t &key, mesh_data_t &&m, source_t source);
+    std::map<geometry_key_t, std::weak_ptr<shape_t>> meshes;
+    std::string diskDir = "mesh_cache";
+    bool diskDirMade = false;
+
+    std::string disk_path(const geometry_key_t &key) const;
+    void make_disk_dir();
+    bool load_disk(const geometry_key_t &key, mesh_data_t &out) const;
+    bool save_disk(const geometry_key_t &key, const mesh_data_t &m) const;
+};
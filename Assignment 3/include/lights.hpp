@@ -0,0 +1,47 @@
+// -----------------------------------------------------------------------------
+// lights.hpp
+// Dynamic point-light list, culled each frame into a view-space cluster grid
+// (screen tiles x exponential depth slices). The shader looks up the cluster
+// of a vertex (or fragment) and evaluates only the lights listed there.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "frame_uniforms.hpp"
+#include "shader_cache.hpp"
+
+struct point_light_t {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    float radius = 0.0f; // range of influence; <= 0: unbounded, no falloff, in every cluster
+    bool on = true;
+};
+
+class light_list_t {
+public:
+    static const int TILES_X = 16, TILES_Y = 9, SLICES = 24;
+    static const int CLUSTERS = TILES_X * TILES_Y * SLICES;
+    // texture units of the light, cluster and index buffers
+    static const int LIGHT_UNIT = 1, CLUSTER_UNIT = 2, INDEX_UNIT = 3;
+
+    std::vector<point_light_t> lights;
+
+    // Point the program's light samplers at our units (program in use, once)
+    static void attach(GLuint prog);
+    // Cull the lights that are on into clusters of this camera (glm::perspective
+    // proj), upload the lists, bind them and fill the frame block's cluster fields
+    // (counts go to render_stats_t). Returns the LIGHT_MODE permutation bits
+    // the frame needs (SHADER_LIGHTS_*).
+    uint32_t build(const glm::mat4 &view, const glm::mat4 &proj, frame_block_t &frame);
+
+private:
+    GLuint buffers[3] = {}, textures[3] = {};
+    std::vector<glm::vec4> lightTexels;  // 2 per light: xyz + radius, rgb
+    std::vector<GLuint> clusterTexels;   // 2 per cluster: first index, count
+    std::vector<GLuint> indexTexels;     // light ids grouped by cluster
+    struct span_t { GLuint light; glm::ivec3 lo, hi; }; // clusters a bounded light touches
+    std::vector<span_t> spans;
+
+    void upload(int i, GLenum format, const void *data, size_t bytes);
+};
@@ -1,6 +1,6 @@
 // -----------------------------------------------------------------------------
 // line_strip.hpp : Utility shape for visualizing paths (Bezier, control polygon).
-// Stores vertices and colors; normals are dummy upward vectors.
+// Stores vertices only (color comes from the node); normals are dummy upward vectors.
 // -----------------------------------------------------------------------------
 #pragma once
 #include "shape.hpp"
@@ -16,51 +16,35 @@ private:
     GLenum gl_draw_mode;        // To store GL_LINE_STRIP
     
     
-    //Creates the VBOs and VAO for this line strip.
+    //Creates the VBO and VAO for this line strip (same vertex format as shapes).
     void init_vbo() {
-        // Based on the 'vbo' array used in your main.cpp
-        glGenBuffers(4, vbo); // vbo[0-3]
+        glGenBuffers(1, &vbo);
         glGenVertexArrays(1, &vao);
         glBindVertexArray(vao);
 
-        // VBO 0: Vertices
-        glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec4), vertices.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        // Interleaved positions + dummy normals/uvs
+        std::vector<unsigned char> packed = format->pack(vertices, normals, uvs);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+        format->apply();
 
-        // VBO 1: Colors
-        glBindBuffer(GL_ARRAY_BUFFER, vbo[1]);
-        glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec4), colors.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-        // VBO 2: Normals (dummy data)
-    glBindBuffer(GL_ARRAY_BUFFER, vbo[2]);
-    // Use vec3 normals to match vertex shader (location=2 expects vec3)
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), normals.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-        
-        // No index buffer (vbo[3]) needed for GL_LINE_STRIP
+        // No index buffer needed for GL_LINE_STRIP
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
     }
 
 public:
-    line_strip_t(const std::vector<glm::vec3>& points, const glm::vec4& color) : shape_t(0) {
+    line_strip_t(const std::vector<glm::vec3>& points) : shape_t(0) {
         
         gl_draw_mode = GL_LINE_STRIP;
         
         // Populate vertex data 
         vertices.reserve(points.size());
-        colors.reserve(points.size());
         normals.reserve(points.size());
         uvs.reserve(points.size());    
 
         for (const auto& p : points) {
             vertices.push_back(glm::vec4(p, 1.0f));    // position
-            colors.push_back(color);                   // uniform color for strip
             normals.push_back(glm::vec3(0, 1, 0));     // dummy upward normal
             uvs.push_back(glm::vec2(0, 0));            // unused placeholder
         }
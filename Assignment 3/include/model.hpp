@@ -6,24 +6,109 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <vector>
 #include <string>
 #include <memory>
 #include "shape.hpp"
+#include "render_queue.hpp"
 
 // A single node in the hierarchy. Children inherit cumulative transforms.
+// Shapes may be shared between nodes (see geometry_cache.hpp).
+// Local transform is stored compactly as translation / rotation quaternion /
+// scale and composed into matrices only when the node is (re)computed.
+// HNode is the editing front-end; model_t compiles the tree into flat arrays
+// (flat_nodes_t) that drawing and world-frame propagation run on. After changing
+// translation/rotation/scale, shape or material of an existing node call
+// mark_dirty() (or use the set_* helpers); the node and its subtree are
+// recomputed on the next pass, and baked subtrees containing it are re-merged.
 struct HNode {
-    std::unique_ptr<shape_t> shape;
-    glm::mat4 translate = glm::mat4(1.0f);
-    glm::mat4 rotate = glm::mat4(1.0f);
-    glm::mat4 scale = glm::mat4(1.0f);
-    glm::vec4 color = glm::vec4(1.0f);
+    std::shared_ptr<shape_t> shape;
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+    bool dirty = true;            // local TRS changed since last propagation
+    bool bounds_dirty = true;     // shape replaced since last propagation (set_shape)
+    bool topology_dirty = true;   // root only: children added/removed since compile
+    int flat_index = -1;          // slot in the owning model's flat_nodes_t
+    glm::vec4 color = glm::vec4(1.0f); // material base color (per-draw iColor)
     // Texture support
     unsigned int texture = 0; // OpenGL texture id (0 means none)
     bool useTexture = false;  // whether to sample texture in shader
+    bool perPixel = false;    // light per fragment instead of per vertex (shader permutation)
+    // Static subtree: drawn as merged meshes (one per material) with the node
+    // transforms pre-applied; re-baked when an edit below is reported (mark_dirty, set_*)
+    bool bake = false;
+    bool bake_edited = false; // bake roots: merged meshes out of date
     std::vector<std::unique_ptr<HNode>> children;
+    HNode* parent = nullptr;  // set by add_child
     HNode() = default;
-    HNode(std::unique_ptr<shape_t> s): shape(std::move(s)) {}
+    HNode(std::shared_ptr<shape_t> s): shape(std::move(s)) {}
+
+    // Attach a child (keeps the parent link used by world-frame queries)
+    HNode* add_child(std::unique_ptr<HNode> c){
+        c->parent = this;
+        c->dirty = true;
+        children.push_back(std::move(c));
+        HNode* r = this;
+        while(r->parent) r = r->parent;
+        r->topology_dirty = true;
+        return children.back().get();
+    }
+    // T * R
+    glm::mat4 local_frame() const {
+        glm::mat4 m = glm::mat4_cast(rotation);
+        m[3] = glm::vec4(translation, 1.0f);
+        return m;
+    }
+    void mark_dirty(){ dirty = true; edited(this); }
+    // A bake root's own frame only places its merged meshes, so moving or
+    // turning it does not re-merge them
+    void set_translation(const glm::vec3 &t){ if(t != translation){ translation = t; dirty = true; edited(parent); } }
+    void set_rotation(const glm::quat &q){ if(q != rotation){ rotation = q; dirty = true; edited(parent); } }
+    void set_scale(const glm::vec3 &s){ if(s != scale){ scale = s; dirty = true; edited(this); } }
+    void set_shape(std::shared_ptr<shape_t> s){ if(s != shape){ shape = std::move(s); bounds_dirty = true; edited(this); } }
+    // Bake roots are collected at compile time, so toggling recompiles
+    void set_bake(bool b){
+        if(b == bake) return;
+        bake = b;
+        HNode* r = this;
+        while(r->parent) r = r->parent;
+        r->topology_dirty = true;
+    }
+private:
+    // Flag every bake root from n up (the edit changes what they merge)
+    static void edited(HNode* n){ for(; n; n = n->parent) if(n->bake) n->bake_edited = true; }
+};
+
+// Merged meshes of one baked subtree (see HNode::bake)
+struct bake_t {
+    int root = -1;                  // flat index of the subtree root
+    std::vector<std::pair<const HNode*, std::shared_ptr<shape_t>>> meshes; // material node, merged mesh
+    std::vector<int> loose;         // nodes that cannot be merged (line strips), drawn as usual
+    size_t nodes = 0;               // shape nodes merged
+    bool built = false;
+};
+
+// Compiled form of a model: nodes in depth-first order, so parents precede
+// children and world frames propagate in one linear pass over the arrays.
+struct flat_nodes_t {
+    std::vector<HNode*> node;           // editing node (TRS source, material)
+    std::vector<int> parent;            // index into these arrays, -1 for the root
+    std::vector<int> subtree_end;       // one past the last descendant (skip target when culled)
+    std::vector<glm::mat4> local;       // T * R, filled for the nodes recomputed in a pass
+    std::vector<glm::mat4> world;       // parentWorld * T * R (no scale)
+    std::vector<glm::mat4> model;       // world * S
+    std::vector<aabb_t> box;            // local bounds of the node's own shape
+    std::vector<aabb_t> own;            // world bounds of the node's own shape
+    std::vector<aabb_t> bounds;         // world bounds of the node's subtree (shapes only)
+    std::vector<bake_t> bakes;          // one per HNode::bake subtree root
+    std::vector<unsigned char> changed; // recomputed in the last pass
+    std::vector<int> work;              // indices recomputed in the last pass, ascending
+    std::vector<int> rebound;           // own box redone in the last pass (work + new shapes), ascending
+    std::vector<int> regrow;            // subtree box redone: rebound and their ancestors
+    std::vector<unsigned char> mark;    // in regrow (cleared after each pass)
+    size_t size() const { return node.size(); }
 };
 
 class model_t {
@@ -39,19 +124,34 @@ public:
     model_t& operator=(model_t&&) noexcept = default;
 
     void clear();
-    HNode* add_shape(std::unique_ptr<shape_t> s);
+    HNode* add_shape(std::shared_ptr<shape_t> s);
     void remove_last();
     glm::vec3 compute_centroid() const;
-    bool save(const std::string &fname) const;
+    // Files live in models/; a .modb name selects the binary format
+    // (model_binary.hpp), embedMeshes also stores the tessellated primitives
+    bool save(const std::string &fname, bool embedMeshes = false) const;
     bool load(const std::string &fname);
 
-    // Render using Gouraud: needs MVP and Model matrix
-    // Depth-first traversal: builds MVP/model matrices and draws each node
-    void draw_recursive(HNode* node, const glm::mat4 &parentVP, const glm::mat4 &parentWorld, GLuint mvpLoc, GLuint modelLoc, GLint useTexLoc) const;
-    void draw(GLuint mvpLoc, GLuint modelLoc, const glm::mat4 &viewProj, GLint useTexLoc) const;
+    // Linear pass over the compiled arrays; world places the model root.
+    // Subtrees whose bounds are outside the viewProj frustum are skipped and
+    // each visible shape node becomes one packet in q.
+    void enqueue(render_queue_t &q, const glm::mat4 &viewProj, const glm::mat4 &world = glm::mat4(1.0f)) const;
+    // Render this model on its own (enqueue + submit; Frame block must be current)
+    // frameKey: the frame's SHADER_LIGHTS_* bits (see render_queue_t::submit)
+    void draw(uint32_t frameKey, const glm::mat4 &viewProj, const glm::mat4 &world = glm::mat4(1.0f)) const;
+
+    // Rebuild the flat arrays from the HNode tree (done lazily on topology change)
+    void compile() const;
+    // Bring flat world matrices up to date (compiles first if needed)
+    void update_world(const glm::mat4 &parentWorld = glm::mat4(1.0f)) const;
+    const flat_nodes_t& flat_nodes() const { return flat; }
+    // World-space AABB of all shapes (analytic local bounds, O(nodes))
+    aabb_t world_bounds(const glm::mat4 &world = glm::mat4(1.0f)) const;
 
-    // Utility: compute world transform (frame without scale) of a given node
+    // Utility: world transform (frame without scale) of a given node, O(depth)
     bool get_world_frame_of(const HNode* target, glm::mat4 &outWorld) const;
 private:
-    bool get_world_frame_of_rec(const HNode* node, const HNode* target, const glm::mat4 &parentWorld, glm::mat4 &outWorld) const;
+    void rebake(bake_t &b) const;
+    mutable flat_nodes_t flat;
+    mutable glm::mat4 rootWorld = glm::mat4(1.0f); // parent frame the root was last computed with
 };
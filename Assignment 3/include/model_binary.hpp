@@ -0,0 +1,59 @@
+// -----------------------------------------------------------------------------
+// model_binary.hpp
+// .modb: binary sibling of the text .mod format (same node data, see
+// model_t::save). Fixed-size little-endian records, so a file is mapped and its
+// node table read in place instead of parsed:
+//   header | node table (depth-first, parents first) | mesh table | blob
+// The optional blob holds the tessellated primitives the nodes use; loading
+// gives them to this file's nodes instead of generating them again (they are
+// not shared with procedural users of the same key, see geometry_cache_t::adopt).
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <string>
+
+struct HNode;
+
+static const uint32_t MODB_VERSION = 1;
+
+struct modb_header_t {
+    char magic[4];          // "MODB"
+    uint32_t version;       // MODB_VERSION
+    uint32_t node_count;
+    uint32_t mesh_count;    // 0: no embedded meshes
+    uint64_t node_offset;   // file offsets of the tables and the blob
+    uint64_t mesh_offset;
+    uint64_t blob_offset;
+    uint64_t blob_bytes;
+};
+
+struct modb_node_t {
+    int32_t parent;         // index of an earlier node, -1: top level
+    uint8_t shape;          // 0: none, else ShapeType + 1
+    uint8_t level;
+    uint16_t reserved;
+    float color[4];
+    float translation[3];
+    float scale[3];
+    float rotation[4];      // quaternion x, y, z, w
+};
+
+// One primitive in the blob: vertices (vec4), normals (vec3), texcoords
+// (vec2), then indices (uint32), starting at offset into the blob
+struct modb_mesh_t {
+    uint8_t shape;          // ShapeType
+    uint8_t level;
+    uint16_t reserved;
+    float dims[3];          // geometry_key_t::dims
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint64_t offset;
+};
+
+static_assert(sizeof(modb_header_t) == 48 && sizeof(modb_node_t) == 64 && sizeof(modb_mesh_t) == 32,
+              ".modb records must have no padding");
+
+// Write root and its subtree; embedMeshes adds the blob
+bool save_modb(const HNode* root, const std::string &filepath, bool embedMeshes);
+// Append the file's top-level nodes (with their subtrees) to root
+bool load_modb(const std::string &filepath, HNode* root);
@@ -0,0 +1,51 @@
+// -----------------------------------------------------------------------------
+// render_queue.hpp
+// Traversal and GL submission are split: models emit compact draw packets
+// into a render_queue_t, which sorts them by state (shader permutation,
+// texture, mesh, then depth) and submits them. Arena meshes are drawn with one multi-draw
+// per material (one indirect command per mesh, instanced over its nodes).
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "shape.hpp"
+
+struct HNode;
+
+// Sort key, most significant first:
+//   [63..56] program (material permutation bits, shader_cache.hpp)
+//   [55..40] texture (id << 1 | useTexture)  [39..20] mesh id  [19..0] depth
+// Texture and mesh ids are truncated to their fields: equal keys only group
+// packets for sorting, runs are split on the actual texture and mesh.
+struct draw_packet_t {
+    uint64_t key;
+    shape_t* mesh;
+    const HNode* material;  // color / texture / useTexture / perPixel
+    uint32_t matrix;        // index into render_queue_t::matrices
+};
+
+class render_queue_t {
+public:
+    static constexpr int DEPTH_BITS = 20;
+
+    void clear(){ packets.clear(); matrices.clear(); }
+    size_t size() const { return packets.size(); }
+    // depth: clip-space w of the node (distance along the view direction)
+    void push(shape_t* mesh, const HNode* material, const glm::mat4 &model, float depth);
+    // Sort and issue the GL calls; the queue is left filled (clear() per frame).
+    // Each packet's program is its material permutation combined with
+    // frameKey (the frame's SHADER_LIGHTS_* bits); per-draw data are vertex
+    // attributes and ViewProj comes from the Frame uniform block.
+    void submit(uint32_t frameKey);
+
+private:
+    std::vector<draw_packet_t> packets;
+    std::vector<glm::mat4> matrices;
+    // submission scratch
+    struct run_t { size_t begin, end; int command; }; // command: index into commands, -1 = own VAO
+    std::vector<run_t> runs;
+    std::vector<instance_data_t> instances;         // per-draw records of arena runs
+    std::vector<draw_elements_indirect_t> commands;
+};
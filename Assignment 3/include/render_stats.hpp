@@ -0,0 +1,56 @@
+// -----------------------------------------------------------------------------
+// render_stats.hpp
+// Per-frame counters filled by the draw traversal. `cur` accumulates the frame
+// being rendered; end_frame() publishes it as `last` (printed with 'G').
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstddef>
+#include <iostream>
+
+struct render_stats_t {
+    struct frame_t {
+        size_t nodes = 0;          // nodes in the drawn models
+        size_t visible = 0;        // shape nodes that passed frustum culling (drawn)
+        size_t culled = 0;         // nodes skipped with their culled subtree
+        size_t draw_calls = 0;     // glDraw* calls issued (one per visible node without instancing)
+        size_t instanced = 0;      // visible nodes drawn through the arena (instanced/indirect)
+        size_t indirect_commands = 0; // indirect commands (one per mesh run) in those draws
+        size_t baked = 0;          // visible nodes drawn through merged static meshes
+        size_t rebakes = 0;        // static subtrees (re)merged
+        size_t program_binds = 0;  // glUseProgram calls (material permutations; no per-draw uniforms)
+        size_t state_changes = 0;  // program / texture / VAO changes in sorted submission
+        size_t state_changes_unsorted = 0; // the same in traversal order
+        size_t world_updates = 0;  // nodes whose cached world matrix was recomputed
+        size_t world_queries = 0;  // get_world_frame_of calls
+        size_t query_steps = 0;    // ancestor links walked by those queries
+        size_t lights = 0;         // point lights on
+        size_t clusters = 0;       // cells of the light cluster grid
+        size_t light_refs = 0;     // entries in the per-cluster light lists
+        size_t light_max = 0;      // longest cluster list
+        double cluster_ms = 0.0;   // CPU time to cull lights into clusters and upload
+    };
+    frame_t cur, last;
+    size_t frames = 0;
+
+    static render_stats_t& instance(){
+        static render_stats_t s;
+        return s;
+    }
+    void end_frame(){ last = cur; cur = frame_t(); frames++; }
+    void print() const {
+        std::cout << "Frame " << frames << ": " << last.nodes << " nodes, "
+                  << last.world_updates << " world matrices recomputed\n";
+        std::cout << "  culling: " << last.visible << " visible, " << last.culled << " culled\n";
+        std::cout << "  draw calls: " << last.draw_calls << " (" << last.visible << " one per node; "
+                  << last.instanced << " nodes in " << last.indirect_commands << " indirect commands, "
+                  << last.baked << " baked, "
+                  << last.rebakes << " rebakes)\n";
+        std::cout << "  state changes: " << last.state_changes << " (" << last.state_changes_unsorted
+                  << " in traversal order), " << last.program_binds << " program binds\n";
+        std::cout << "  world-frame queries: " << last.world_queries << ", "
+                  << last.query_steps << " ancestor steps\n";
+        std::cout << "  lights: " << last.lights << " on, " << last.light_refs << " cluster entries (avg "
+                  << (last.clusters ? double(last.light_refs) / last.clusters : 0.0) << ", max "
+                  << last.light_max << " per cluster), " << last.cluster_ms << " ms to build\n";
+    }
+};
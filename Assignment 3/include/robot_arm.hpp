@@ -51,7 +51,7 @@ public:
     RobotArm();
     void init();  // Build hierarchy (call only after GL context is valid)
     void updateJoints();
-    void draw(GLuint mvpLoc, GLuint modelLoc, const glm::mat4 &viewProj, GLint useTexLoc);
+    void enqueue(render_queue_t &q, const glm::mat4 &viewProj);
 
 
     void setPose(const SceneKey& key); // Apply angles/gripper from SceneKey
@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------------
+// shader_cache.hpp
+// Compile-time permutations of basic.vert / basic.frag. A permutation key
+// selects #defines injected after the #version line (with lighting.glsl in
+// front of each stage), so branches on material and light setup are resolved
+// by the compiler instead of per fragment. Programs are built once per key;
+// linked binaries are kept on disk (glGetProgramBinary) under a hash of the
+// sources and the driver, so later launches skip compilation.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+struct HNode;
+
+// Permutation key bits
+enum : uint32_t {
+    SHADER_TEXTURED  = 1u << 0, // TEXTURED: modulate by the `tex` sampler
+    SHADER_PER_PIXEL = 1u << 1, // PER_PIXEL: light in the fragment shader
+    SHADER_MATERIAL_MASK = SHADER_TEXTURED | SHADER_PER_PIXEL,
+    // LIGHT_MODE (bits 2-3), one per frame: ambient only, unbounded lights
+    // only (no cluster lookup), clustered lights (lights.hpp)
+    SHADER_LIGHTS_NONE      = 0u << 2,
+    SHADER_LIGHTS_GLOBAL    = 1u << 2,
+    SHADER_LIGHTS_CLUSTERED = 2u << 2,
+    SHADER_LIGHTS_MASK      = 3u << 2,
+    SHADER_PERMUTATIONS     = 12u, // keys 0..11
+};
+
+class shader_cache_t {
+public:
+    static shader_cache_t& instance();
+
+    // Directory holding basic.vert, basic.frag and lighting.glsl
+    void set_directory(const std::string &d){ dir = d; }
+    // Directory for program binaries ("" disables the disk cache)
+    void set_binary_directory(const std::string &d){ binaryDir = d; }
+    // Linked program for key, loaded or compiled on first use (exits on
+    // compile errors). Frame block, light samplers and `tex` are bound once here.
+    GLuint program(uint32_t key);
+    // Build every permutation up front (no compile hitch when lights change).
+    // All compiles are issued before any status is read, so drivers with
+    // KHR_parallel_shader_compile build them concurrently.
+    void preload();
+    // Material half of the key for a node
+    static uint32_t material_key(const HNode* material);
+
+    void print_stats() const;
+
+private:
+    // A program between issuing its compile/link (or binary load) and use
+    struct pending_t {
+        uint32_t key;
+        GLuint program, vs = 0, fs = 0; // shaders only when compiled from source
+        uint64_t hash = 0;
+    };
+    std::string dir = "shaders";
+    std::string binaryDir = "shader_cache";
+    std::string sources[3]; // vert, frag, lighting (read on first compile)
+    std::string driver;     // vendor / renderer / version, part of the binary hash
+    std::vector<GLint> formats; // binary formats the driver accepts (none: cache off)
+    std::map<uint32_t, GLuint> programs;
+    double compile_ms = 0.0;
+    size_t loaded = 0, compiled = 0, saved = 0;
+
+    void init();
+    pending_t begin(uint32_t key);
+    GLuint finish(const pending_t &p);
+    std::string stage_source(GLenum type, const std::string &defines) const;
+    std::string binary_path(uint64_t hash) const;
+    bool load_binary(GLuint program, uint64_t hash);
+    void save_binary(GLuint program, uint64_t hash);
+};
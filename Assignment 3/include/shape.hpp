@@ -1,30 +1,57 @@
 // -----------------------------------------------------------------------------
 // shape.hpp
-// Minimal base for drawable shapes (positions, colors, normals, uvs + GL buffers)
-// Owns VAO/VBOs and provides a small helper to upload attribute arrays.
-// NOTE: This file intentionally avoids any behavior changes—comments only.
+// Minimal base for drawable shapes (positions, normals, uvs + GL buffers)
+// Indexed meshes live in the shared vertex_arena_t (a sub-range of its
+// VBO/EBO); unindexed geometry owns a VAO/VBO with the selected vertex_format_t.
 // -----------------------------------------------------------------------------
 #pragma once
 #include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 #include <string>
+#include "vertex_format.hpp"
+#include "bounds.hpp"
+#include "vertex_arena.hpp"
 
 
 enum ShapeType { SPHERE_SHAPE, CYLINDER_SHAPE, BOX_SHAPE, CONE_SHAPE };
 
+// CPU arrays of a tessellated mesh (from a primitive's build(), a .modb file
+// or the disk cache), handed to its prebuilt constructor for upload
+struct mesh_data_t {
+    std::vector<glm::vec4> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> texcoords;
+    std::vector<GLuint> indices;
+    // Optional: the vertices already interleaved in packed_format (uploaded as
+    // is when that is the shape's format)
+    std::vector<unsigned char> packed;
+    const vertex_format_t* packed_format = nullptr;
+};
+
 class shape_t {
 public:
     ShapeType shapetype;
     unsigned int level;
     std::vector<glm::vec4> vertices;
-    std::vector<glm::vec4> colors;
     std::vector<glm::vec3> normals;   // per-vertex normals
     std::vector<glm::vec2> texcoords; // optional UVs
+    std::vector<GLuint> indices;      // triangle list into the arrays above (empty = unindexed)
 
-    // GL buffers: 0-pos,1-color,2-normal,3-uv
+    // GL buffers: one interleaved VBO (layout = format) for unindexed geometry,
+    // or a range of the shared arena when indexed
     GLuint vao=0;
-    GLuint vbo[4]={0,0,0,0};
+    GLuint vbo=0;
+    GLuint ebo=0;
+    vertex_arena_t* arena = nullptr;
+    arena_range_t range;
+    const vertex_format_t* format = default_format;
+    // Small unique id (render queue sort key)
+    static inline uint32_t id_counter = 0;
+    const uint32_t id = ++id_counter;
+    // Layout used by setup_buffers() for newly created shapes
+    static inline const vertex_format_t* default_format = &vertex_format_t::packed();
 
     // centroid for pivoting (computed from vertices)
     glm::vec3 centroid = glm::vec3(0.0f);
@@ -32,14 +59,40 @@ public:
     // Constrain tessellation level to a small bound (defensive cap only)
     shape_t(unsigned int lev): level(lev) { if(level>4) level=4; }
     virtual ~shape_t(){
-        if(vbo[0]) glDeleteBuffers(4,vbo);
+        if(vbo) glDeleteBuffers(1,&vbo);
+        if(ebo) glDeleteBuffers(1,&ebo);
+        if(arena) arena->release(range);
         if(vao) glDeleteVertexArrays(1,&vao);
     }
     // Contract for subclasses:
-    // - Fill vertices/colors/normals/texcoords in ctor, then call setup_buffers().
+    // - Fill vertices/normals/texcoords (and indices) in ctor, then call setup_buffers().
     // - draw() should bind VAO and issue a GL draw with correct primitive mode.
     virtual void draw() = 0;
     virtual std::string name() const = 0;
+    // Indexed meshes in the shared arena can be batched into indirect draws
+    bool in_arena() const { return arena != nullptr; }
+    // Local-space bounds. Primitives override with closed forms; the default
+    // scans the vertex array (line strips and other ad-hoc geometry).
+    virtual aabb_t local_bounds() const {
+        aabb_t b;
+        for(auto &v: vertices) b.grow(glm::vec3(v));
+        return b;
+    }
+    virtual bsphere_t local_sphere() const {
+        aabb_t b = local_bounds();
+        if(b.empty()) return bsphere_t();
+        return { b.center(), glm::length(b.half()) };
+    }
+
+    // Bytes held in GPU vertex/index buffers by this shape
+    size_t gpu_bytes() const {
+        return vertices.size()*vertex_bytes() + indices.size()*sizeof(GLuint);
+    }
+    // Vertices the shader runs on per draw (one per index when indexed)
+    size_t drawn_vertex_count() const { return indices.empty() ? vertices.size() : indices.size(); }
+    // What the same triangles would cost as an unindexed glDrawArrays mesh
+    size_t unindexed_bytes() const { return drawn_vertex_count()*vertex_bytes(); }
+    size_t vertex_bytes() const { return format->stride; }
 
 protected:
     // Compute simple arithmetic mean of points as a local pivot
@@ -49,39 +102,55 @@ protected:
         for(auto &v: vertices) s += glm::vec3(v);
         centroid = s / float(vertices.size());
     }
-    // Uploads attribute arrays (positions, colors, normals, uvs) and sets VAO state
-    void setup_buffers(){
+    // Take prebuilt arrays and upload them
+    void adopt(mesh_data_t &&m){
+        vertices = std::move(m.vertices); normals = std::move(m.normals);
+        texcoords = std::move(m.texcoords); indices = std::move(m.indices);
+        if(m.packed_format != format || m.packed.size() != vertices.size() * format->stride) m.packed.clear();
+        setup_buffers(std::move(m.packed));
+    }
+    // Uploads positions/normals/uvs interleaved into one VBO and sets VAO state
+    // (packed: the same already interleaved in format, empty: pack them here)
+    void setup_buffers(std::vector<unsigned char> packed = {}){
         compute_centroid();
         if(vertices.empty()) return;
         // ensure arrays sizes match
-        if(colors.size() != vertices.size()) colors.assign(vertices.size(), glm::vec4(1.0f));
         if(normals.size() != vertices.size()) normals.assign(vertices.size(), glm::vec3(0,1,0));
         if(texcoords.size() != vertices.size()) texcoords.assign(vertices.size(), glm::vec2(0.0f));
+        if(packed.empty()) packed = format->pack(vertices, normals, texcoords);
 
+        if(!indices.empty() && format == &vertex_arena_t::instance().format()){
+            arena = &vertex_arena_t::instance();
+            range = arena->alloc(packed, GLuint(vertices.size()), indices);
+            return;
+        }
         glGenVertexArrays(1,&vao);
         glBindVertexArray(vao);
-        glGenBuffers(4,vbo);
-        // positions
-        glBindBuffer(GL_ARRAY_BUFFER,vbo[0]);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size()*sizeof(glm::vec4), vertices.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0,4,GL_FLOAT,GL_FALSE,0,(void*)0);
-        // colors
-        glBindBuffer(GL_ARRAY_BUFFER,vbo[1]);
-        glBufferData(GL_ARRAY_BUFFER, colors.size()*sizeof(glm::vec4), colors.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1,4,GL_FLOAT,GL_FALSE,0,(void*)0);
-        // normals
-        glBindBuffer(GL_ARRAY_BUFFER,vbo[2]);
-        glBufferData(GL_ARRAY_BUFFER, normals.size()*sizeof(glm::vec3), normals.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,0,(void*)0);
-        // texcoords
-        glBindBuffer(GL_ARRAY_BUFFER,vbo[3]);
-        glBufferData(GL_ARRAY_BUFFER, texcoords.size()*sizeof(glm::vec2), texcoords.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3,2,GL_FLOAT,GL_FALSE,0,(void*)0);
+        glGenBuffers(1,&vbo);
+        glBindBuffer(GL_ARRAY_BUFFER,vbo);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
+        format->apply();
+        // indices (element buffer binding is recorded in the VAO)
+        if(!indices.empty()){
+            glGenBuffers(1,&ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        }
 
         glBindVertexArray(0);
     }
+    // Shared draw for indexed triangle meshes
+    void draw_elements(GLenum mode = GL_TRIANGLES){
+        if(arena){
+            arena->bind();
+            glDrawElementsBaseVertex(mode, (GLsizei)range.index_count, GL_UNSIGNED_INT,
+                                     (void*)(size_t(range.first_index)*sizeof(GLuint)), range.base_vertex);
+            glBindVertexArray(0);
+            return;
+        }
+        if(vao==0) return;
+        glBindVertexArray(vao);
+        glDrawElements(mode,(GLsizei)indices.size(),GL_UNSIGNED_INT,(void*)0);
+        glBindVertexArray(0);
+    }
 };
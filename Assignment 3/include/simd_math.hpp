@@ -0,0 +1,54 @@
+// -----------------------------------------------------------------------------
+// simd_math.hpp
+// Matrix kernels for the hot CPU loops (world-frame propagation, world
+// bounds). Scalar (glm), SSE and AVX2/FMA variants are compiled in and one is
+// picked at startup from the CPU features; the SIMD build variable
+// (make SIMD=scalar|sse|avx2, default auto) caps the choice.
+// ./model --bench kernels times each one.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include "bounds.hpp"
+
+struct mat_kernels_t {
+    const char* name;
+    // out = a * b
+    void (*mul)(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out);
+    // Hierarchy chain over the nodes in idx (ascending, so parents come first;
+    // null: 0..count-1): world[i] = (parent[i] < 0 ? top : world[parent[i]]) * local[i]
+    void (*propagate)(const glm::mat4 &top, const int* parent, const glm::mat4* local, glm::mat4* world, const int* idx, size_t count);
+    // out[i] = box[i].transformed(m[i]) for the nodes in idx (null: 0..count-1)
+    void (*bounds)(const glm::mat4* m, const aabb_t* box, aabb_t* out, const int* idx, size_t count);
+
+    static const mat_kernels_t& scalar();
+    // Every variant this CPU can run, scalar first
+    static std::vector<const mat_kernels_t*> supported();
+    static const mat_kernels_t& active();
+};
+
+// Normal matrix transpose(inverse(mat3(m))) as three xyz columns. When the
+// 3x3 part is a rotation times a uniform scale (every frame in the robot and
+// room), mat3(m) is returned as is: it differs from the normal matrix only by
+// a scale factor, which the shader's normalize() removes.
+inline void normal_matrix(const glm::mat4 &m, glm::vec4 out[3]){
+    glm::vec3 c0(m[0]), c1(m[1]), c2(m[2]);
+    float l0 = glm::dot(c0, c0), l1 = glm::dot(c1, c1), l2 = glm::dot(c2, c2);
+    float eps = 1e-4f * l0;
+    if(std::abs(l1 - l0) <= eps && std::abs(l2 - l0) <= eps &&
+       std::abs(glm::dot(c0, c1)) <= eps && std::abs(glm::dot(c0, c2)) <= eps && std::abs(glm::dot(c1, c2)) <= eps){
+        out[0] = glm::vec4(c0, 0.0f); out[1] = glm::vec4(c1, 0.0f); out[2] = glm::vec4(c2, 0.0f);
+        return;
+    }
+    glm::mat3 n = glm::transpose(glm::inverse(glm::mat3(m)));
+    out[0] = glm::vec4(n[0], 0.0f); out[1] = glm::vec4(n[1], 0.0f); out[2] = glm::vec4(n[2], 0.0f);
+}
+
+// Convenience wrapper for the common single product
+inline glm::mat4 mat_mul(const glm::mat4 &a, const glm::mat4 &b){
+    glm::mat4 r;
+    mat_kernels_t::active().mul(a, b, r);
+    return r;
+}
@@ -7,6 +7,12 @@ class sphere_t: public shape_t {
 public:
     float radius;
     sphere_t(unsigned int lev=1, float r=0.5f);
+    // Arrays from an earlier tessellation with the same parameters
+    sphere_t(unsigned int lev, float r, mesh_data_t &&prebuilt);
+    // Tessellation only (no GL calls, safe on any thread)
+    static mesh_data_t build(unsigned int lev, float r);
     virtual void draw() override;
     virtual std::string name() const override { return "sphere"; }
+    virtual aabb_t local_bounds() const override { return aabb_t(glm::vec3(-radius), glm::vec3(radius)); }
+    virtual bsphere_t local_sphere() const override { return { glm::vec3(0.0f), radius }; }
 };
@@ -0,0 +1,34 @@
+// -----------------------------------------------------------------------------
+// stream_ring.hpp
+// Per-frame streaming buffer split into a few segments used round-robin. Each
+// frame's data is written into the next segment with an unsynchronized map;
+// a fence per segment makes the CPU wait only if the GPU is still reading it
+// (i.e. when it is more than SEGMENTS frames behind), so nothing is orphaned.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <cstddef>
+#include <GL/glew.h>
+
+class stream_ring_t {
+public:
+    static const int SEGMENTS = 3;
+
+    // align: offsets returned by write() are multiples of it
+    stream_ring_t(GLenum target, size_t align): target(target), align(align) {}
+    GLuint buffer() const { return buf; }
+    // Copy bytes into the next segment; returns its byte offset in buffer().
+    // Re-specifies the store (same buffer name, so VAO bindings stay valid)
+    // after the GPU is done with it when the data does not fit.
+    size_t write(const void* data, size_t bytes);
+    // Call after the draws reading the last write() have been issued
+    void fence();
+
+private:
+    void wait(int s);
+    GLenum target;
+    size_t align;
+    GLuint buf = 0;
+    size_t segment = 0;       // bytes per segment
+    int cur = SEGMENTS - 1;
+    GLsync fences[SEGMENTS] = {};
+};
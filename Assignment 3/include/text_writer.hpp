@@ -0,0 +1,67 @@
+// -----------------------------------------------------------------------------
+// text_writer.hpp
+// Output buffer for the text files (.mod, camera.key, scene.key). Numbers are
+// formatted with std::to_chars, floats in the shortest form that reads back to
+// the same value, and the finished text goes to disk in one write.
+// -----------------------------------------------------------------------------
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+class text_writer_t {
+public:
+    text_writer_t& operator<<(float v){
+        char* p = room(32);
+        // small integers (most rotation entries, colors, unit scales) print
+        // as to_chars would, without its shortest-digit search
+        if(v > -10000.0f && v < 10000.0f && v == float(int(v)) && (v != 0.0f || !std::signbit(v))){
+            int i = int(v);
+            if(unsigned(i) < 10u){ *p = char('0' + i); end = p + 1; }
+            else end = std::to_chars(p, p + 32, i).ptr;
+        }
+        else
+            end = std::to_chars(p, p + 32, v).ptr;
+        return *this;
+    }
+    template<class T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    text_writer_t& operator<<(T v){ char* p = room(32); end = std::to_chars(p, p + 32, v).ptr; return *this; }
+    text_writer_t& operator<<(char c){ *room(1) = c; end++; return *this; }
+    text_writer_t& operator<<(std::string_view s){ memcpy(room(s.size()), s.data(), s.size()); end += s.size(); return *this; }
+    text_writer_t& operator<<(const char* s){ return *this << std::string_view(s); }
+    text_writer_t& operator<<(const std::string &s){ return *this << std::string_view(s); }
+    // n spaces
+    void pad(size_t n){ memset(room(n), ' ', n); end += n; }
+    size_t size() const { return size_t(end - buf.get()); }
+    std::string_view text() const { return std::string_view(buf.get(), size()); }
+
+    // Replace path with the buffer (false if it cannot be written)
+    bool write(const std::string &path) const {
+        FILE* f = fopen(path.c_str(), "wb");
+        if(!f) return false;
+        bool ok = fwrite(buf.get(), 1, size(), f) == size();
+        return (fclose(f) == 0) && ok;
+    }
+
+private:
+    std::unique_ptr<char[]> buf;
+    char *end = nullptr, *cap = nullptr;
+
+    // At least n free bytes at the end (the buffer doubles when full)
+    char* room(size_t n){
+        if(size_t(cap - end) >= n) return end;
+        size_t used = size(), grown = std::max<size_t>(2 * size_t(cap - buf.get()), used + n + 4096);
+        std::unique_ptr<char[]> b(new char[grown]);
+        if(used) memcpy(b.get(), buf.get(), used);
+        buf = std::move(b);
+        end = buf.get() + used;
+        cap = buf.get() + grown;
+        return end;
+    }
+};
@@ -0,0 +1,90 @@
+// -----------------------------------------------------------------------------
+// vertex_arena.hpp
+// All indexed shape geometry lives in one shared VBO/EBO pair. Shapes get a
+// sub-range (base vertex + first index) from a free list, released when the
+// shape goes away (remove_last / clear / re-bake) and reused by later shapes.
+// The arena VAO also carries the per-draw attributes (model matrix, color),
+// so a whole sorted queue can be drawn with glMultiDrawElementsIndirect: each
+// command's baseInstance selects its records in the per-draw buffer. Records
+// and commands are streamed through fenced rings (stream_ring_t).
+// -----------------------------------------------------------------------------
+#pragma once
+#include <map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <GL/glew.h>
+#include "vertex_format.hpp"
+#include "stream_ring.hpp"
+
+// Per-draw attributes: model matrix at locations 4-7, base color at 8 and the
+// normal matrix (xyz of three columns) at 9-11 (see basic.vert)
+struct instance_data_t {
+    glm::mat4 model;
+    glm::vec4 color;
+    glm::vec4 normal[3];
+};
+
+// Layout fixed by GL for GL_DRAW_INDIRECT_BUFFER
+struct draw_elements_indirect_t {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+struct arena_range_t {
+    GLint base_vertex = 0;
+    GLuint first_index = 0;
+    GLuint vertex_count = 0;
+    GLuint index_count = 0;
+};
+
+class vertex_arena_t {
+public:
+    // Created on first use with shape_t::default_format
+    static vertex_arena_t& instance();
+    const vertex_format_t& format() const { return *fmt; }
+
+    arena_range_t alloc(const std::vector<unsigned char> &packed, GLuint vertexCount, const std::vector<GLuint> &indices);
+    void release(const arena_range_t &r);
+    // Room for this many more vertices / indices, one grow each (batch uploads)
+    void reserve(GLuint vertexCount, GLuint indexCount);
+    void bind() const { glBindVertexArray(vao); }
+
+    // Per-frame submission: per-draw records (returns the record index of
+    // inst[0], to be added to baseInstance), then the commands that use them
+    GLuint upload_instances(const instance_data_t* inst, size_t n);
+    void upload_commands(const draw_elements_indirect_t* cmds, size_t n);
+    // Draw uploaded commands [first, first+n); returns GL calls issued
+    size_t multi_draw(size_t first, size_t n);
+    // All draws of this submission issued: fence the ring segments
+    void end_submit();
+    bool indirect() const { return useIndirect; }
+
+    void print_stats() const;
+
+private:
+    // Free spans keyed by offset; grows the backing buffer when nothing fits
+    struct free_list_t {
+        std::map<GLuint, GLuint> spans; // offset -> length
+        GLuint capacity = 0, used = 0;
+        bool take(GLuint n, GLuint &at);
+        void give(GLuint at, GLuint n);
+        void extend(GLuint newCapacity);
+    };
+    explicit vertex_arena_t(const vertex_format_t &f);
+    void grow(GLuint &buffer, GLenum target, free_list_t &list, GLuint need, size_t elemBytes);
+    void setup_vao();
+    void point_instances(GLuint first) const;
+
+    const vertex_format_t* fmt;
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    free_list_t vertices, indices;
+    stream_ring_t records{ GL_ARRAY_BUFFER, sizeof(instance_data_t) };
+    stream_ring_t indirectCmds{ GL_DRAW_INDIRECT_BUFFER, sizeof(draw_elements_indirect_t) };
+    size_t cmdOffset = 0; // byte offset of the current commands in indirectCmds
+    std::vector<draw_elements_indirect_t> commands; // CPU copy for the fallback path
+    bool useIndirect = false, baseInstance = false;
+    size_t ranges = 0;
+};
@@ -0,0 +1,79 @@
+// -----------------------------------------------------------------------------
+// vertex_format.hpp
+// Interleaved vertex layouts. A vertex_format_t describes one VBO (stride +
+// attribute list) and knows how to pack position/normal/uv arrays into it, so
+// shapes and line strips upload a single buffer instead of one per attribute.
+// Color is not part of the vertex stream (per-draw iColor attribute).
+// -----------------------------------------------------------------------------
+#pragma once
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <GL/glew.h>
+
+struct vertex_attrib_t {
+    GLuint location;      // matches layout(location=...) in basic.vert
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+struct vertex_format_t {
+    enum Encoding { FLOAT32, PACKED };
+    const char* name;
+    Encoding encoding;
+    GLsizei stride;
+    std::vector<vertex_attrib_t> attribs;
+
+    // vec3 position, vec3 normal, vec2 uv (32 bytes)
+    static const vertex_format_t& full_float(){
+        static const vertex_format_t f{ "float32", FLOAT32, 32, {
+            {0, 3, GL_FLOAT, GL_FALSE, 0},
+            {2, 3, GL_FLOAT, GL_FALSE, 12},
+            {3, 2, GL_FLOAT, GL_FALSE, 24} } };
+        return f;
+    }
+    // vec3 position, 2_10_10_10 snorm normal, half2 uv (20 bytes)
+    static const vertex_format_t& packed(){
+        static const vertex_format_t f{ "packed", PACKED, 20, {
+            {0, 3, GL_FLOAT, GL_FALSE, 0},
+            {2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 12},
+            {3, 2, GL_HALF_FLOAT, GL_FALSE, 16} } };
+        return f;
+    }
+
+    // Enable/point attributes at the currently bound GL_ARRAY_BUFFER (VAO must be bound)
+    void apply() const {
+        for(const auto &a : attribs){
+            glEnableVertexAttribArray(a.location);
+            glVertexAttribPointer(a.location, a.size, a.type, a.normalized, stride, (void*)a.offset);
+        }
+    }
+
+    // Interleave arrays into stride-sized records (normals/uvs may be empty)
+    std::vector<unsigned char> pack(const std::vector<glm::vec4> &pos,
+                                    const std::vector<glm::vec3> &nrm,
+                                    const std::vector<glm::vec2> &uv) const {
+        std::vector<unsigned char> out(pos.size() * stride);
+        for(size_t i=0;i<pos.size();i++){
+            unsigned char* v = out.data() + i*stride;
+            glm::vec3 p(pos[i]);
+            glm::vec3 n = i < nrm.size() ? nrm[i] : glm::vec3(0,1,0);
+            glm::vec2 t = i < uv.size()  ? uv[i]  : glm::vec2(0.0f);
+            std::memcpy(v, &p, 12);
+            if(encoding == FLOAT32){
+                std::memcpy(v+12, &n, 12);
+                std::memcpy(v+24, &t, 8);
+            } else {
+                uint32_t pn = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+                uint32_t pt = glm::packHalf2x16(t);
+                std::memcpy(v+12, &pn, 4);
+                std::memcpy(v+16, &pt, 4);
+            }
+        }
+        return out;
+    }
+};
@@ -1,17 +1,25 @@
 #version 330 core
 in vec4 litColor;
+#if TEXTURED
 in vec2 uv;
-out vec4 fragColor;
-
 uniform sampler2D tex;
-uniform int useTexture;
+#endif
+#if PER_PIXEL
+in vec3 worldPos;
+in vec3 worldNormal;
+#endif
+out vec4 fragColor;
 
 void main(){
-    if(useTexture==1){
-        vec4 t = texture(tex, uv);
-        // Modulate texture with lighting intensity (use litColor as light factor assuming base color was 1)
-        fragColor = vec4(t.rgb * litColor.rgb, t.a);
-    } else {
-        fragColor = litColor;
-    }
+    vec4 c = litColor;
+#if PER_PIXEL
+    c.rgb = shade(c.rgb, worldPos, normalize(worldNormal), ViewProj * vec4(worldPos, 1.0));
+#endif
+#if TEXTURED
+    vec4 t = texture(tex, uv);
+    // Modulate texture with lighting intensity (use litColor as light factor assuming base color was 1)
+    fragColor = vec4(t.rgb * c.rgb, t.a);
+#else
+    fragColor = c;
+#endif
 }
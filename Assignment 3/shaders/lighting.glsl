@@ -0,0 +1,56 @@
+// Shared by both stages: shader_cache_t inserts this file after the #version
+// line and the permutation #defines (TEXTURED, PER_PIXEL, LIGHT_MODE).
+
+// per-frame constants (frame_block_t in frame_uniforms.hpp)
+layout(std140) uniform Frame {
+    mat4 ViewProj;
+    vec4 clusterDepth;  // x = near, y = slices / log(far/near)
+    ivec4 clusterDims;  // tiles x, tiles y, slices, active lights (LIGHT_MODE 1: the unbounded ones, stored first)
+};
+
+#if LIGHT_MODE > 0
+// lights culled into clusters on the CPU (light_list_t in lights.hpp)
+uniform samplerBuffer lightData;    // 2 texels per light: xyz + radius, rgb
+uniform usamplerBuffer clusterData; // per cluster: first index, count
+uniform usamplerBuffer lightIndex;  // light ids grouped by cluster
+
+vec3 pointLight(int i, vec3 P, vec3 N){
+    vec4 pr = texelFetch(lightData, 2*i);
+    vec3 L = pr.xyz - P;
+    float d = length(L);
+    float att = 1.0;
+    if(pr.w > 0.0){
+        // smooth window reaching zero at the radius the CPU culled with
+        float x = d / pr.w; x *= x;
+        att = clamp(1.0 - x*x, 0.0, 1.0); att *= att;
+    }
+    float ndotl = max(dot(N, L / max(d, 1e-6)), 0.0);
+    return texelFetch(lightData, 2*i+1).rgb * ndotl * att;
+}
+#endif
+
+// Lit color of base at world position P with unit normal N; clip is
+// ViewProj * P (its w is the view depth the clusters are sliced by)
+vec3 shade(vec3 base, vec3 P, vec3 N, vec4 clip){
+    // Lower ambient so large flat surfaces (ceiling) respond more to lights
+    vec3 sum = 0.1 * base;
+    vec3 lit = vec3(0.0);
+#if LIGHT_MODE == 2
+    // lights of this point's cluster; points off screen have none and
+    // evaluate every active light
+    ivec3 c = ivec3(floor((clip.xy / clip.w * 0.5 + 0.5) * vec2(clusterDims.xy)),
+                    floor(log(clip.w / clusterDepth.x) * clusterDepth.y));
+    if(clip.w > 0.0 && all(greaterThanEqual(c, ivec3(0))) && all(lessThan(c, clusterDims.xyz))){
+        uvec2 range = texelFetch(clusterData, (c.z*clusterDims.y + c.y)*clusterDims.x + c.x).xy;
+        for(uint k=0u;k<range.y;k++) lit += pointLight(int(texelFetch(lightIndex, int(range.x + k)).r), P, N);
+    } else
+#endif
+#if LIGHT_MODE > 0
+    {
+        for(int i=0;i<clusterDims.w;i++) lit += pointLight(i, P, N);
+    }
+#endif
+    sum += base * lit;
+    // Clamp to avoid washing out textures
+    return clamp(sum, vec3(0.0), vec3(1.0));
+}
@@ -0,0 +1,425 @@
+// -----------------------------------------------------------------------------
+// bench.cpp : ./model --bench modes (see bench.hpp). Each run takes the best
+// of a few repetitions, so a cold cache or a scheduler hiccup does not count.
+// -----------------------------------------------------------------------------
+#include "bench.hpp"
+#include "model.hpp"
+#include "geometry_cache.hpp"
+#include "frame_uniforms.hpp"
+#include "lights.hpp"
+#include "render_queue.hpp"
+#include "render_stats.hpp"
+#include "robot_arm.hpp"
+#include "shader_cache.hpp"
+#include "simd_math.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using bench_clock = std::chrono::steady_clock;
+
+static double ms_since(bench_clock::time_point t0){
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - t0).count();
+}
+
+// Names of the files in models/ ending in ext, sorted
+static std::vector<std::string> model_files(const std::string &ext){
+    std::vector<std::string> names;
+    if(DIR* d = opendir("models")){
+        while(dirent* e = readdir(d)){
+            std::string n = e->d_name;
+            if(n.size() > ext.size() && n.compare(n.size() - ext.size(), ext.size(), ext) == 0) names.push_back(n);
+        }
+        closedir(d);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static double file_mb(const std::string &name){
+    struct stat st;
+    return stat(("models/" + name).c_str(), &st) == 0 ? double(st.st_size) / (1024.0 * 1024.0) : 0.0;
+}
+
+// Random tree of n nodes under m.root: each node hangs off a random earlier
+// one, with a random shape (or none), level, color and TRS. Fixed seed and
+// modulo draws, so every platform builds the same model.
+static void make_model(model_t &m, size_t n){
+    static const char* types[5] = { "sphere", "box", "cylinder", "cone", "none" };
+    std::mt19937 rng(1);
+    std::vector<HNode*> all{ m.root.get() };
+    all.reserve(n + 1);
+    geometry_cache_t &cache = geometry_cache_t::instance();
+    for(size_t i = 0; i < n; i++){
+        HNode* parent = all[rng() % all.size()];
+        unsigned int type = rng() % 5, lev = rng() % 5;
+        auto node = std::make_unique<HNode>(type < 4 ? cache.by_name(types[type], lev) : nullptr);
+        node->color = glm::vec4(float(rng() % 256) / 255.0f, float(rng() % 256) / 255.0f, float(rng() % 256) / 255.0f, 1.0f);
+        node->translation = glm::vec3(float(rng() % 1000) * 0.01f - 5.0f, float(rng() % 1000) * 0.01f, float(rng() % 1000) * 0.01f - 5.0f);
+        node->scale = glm::vec3(0.5f + float(rng() % 100) * 0.01f);
+        glm::vec3 axis = glm::normalize(glm::vec3(float(rng() % 10 + 1), float(rng() % 10), float(rng() % 10)));
+        node->rotation = glm::angleAxis(float(rng() % 628) * 0.01f, axis);
+        all.push_back(parent->add_child(std::move(node)));
+    }
+}
+
+// Best of 3 loads of models/name, in ms. Meshes stay pinned by the caller, so
+// only the file is read and parsed.
+static double best_load(const std::string &name){
+    double best = 1e30;
+    for(int rep = 0; rep < 3; rep++){
+        model_t m;
+        auto t0 = bench_clock::now();
+        if(!m.load(name)) return -1.0;
+        best = std::min(best, ms_since(t0));
+    }
+    return best;
+}
+
+// Text parser throughput on generated models of 10k, 100k and 1M nodes
+static int bench_parse(){
+    for(size_t n : { size_t(10000), size_t(100000), size_t(1000000) }){
+        model_t m;
+        make_model(m, n);
+        const std::string name = "bench_parse.mod";
+        if(!m.save(name)) return 1;
+        double mb = file_mb(name), t = best_load(name);
+        std::remove(("models/" + name).c_str());
+        if(t < 0.0) return 1;
+        std::printf("%8zu nodes  %7.1f MB  %8.1f ms  %7.1f MB/s  %6.2f M nodes/s\n",
+                    n, mb, t, mb / (t * 1e-3), double(n) / (t * 1e3));
+    }
+    return 0;
+}
+
+// Text vs binary load of the same generated model (default 1M nodes)
+static int bench_load(size_t n){
+    model_t m;
+    make_model(m, n);
+    const std::string text = "bench_load.mod", binary = "bench_load.modb";
+    bool saved = m.save(text) && m.save(binary);
+    double t_text = saved ? best_load(text) : -1.0, t_binary = saved ? best_load(binary) : -1.0;
+    std::printf("%zu nodes\n", n);
+    std::printf("  .mod   %7.1f MB  %8.1f ms\n", file_mb(text), t_text);
+    std::printf("  .modb  %7.1f MB  %8.1f ms\n", file_mb(binary), t_binary);
+    std::remove(("models/" + text).c_str());
+    std::remove(("models/" + binary).c_str());
+    return t_text < 0.0 || t_binary < 0.0 ? 1 : 0;
+}
+
+// Best of 3 runs of passes x body(pass), in ns per node
+template<class F> static double best_ns(size_t passes, size_t n, F body){
+    double best = 1e30;
+    for(int rep = 0; rep < 3; rep++){
+        auto t0 = bench_clock::now();
+        for(size_t pass = 0; pass < passes; pass++) body(pass);
+        best = std::min(best, ms_since(t0));
+    }
+    return best * 1e6 / double(passes * n);
+}
+
+// The update_world work with each kernel set, on the compiled arrays of every
+// model: the chain as one mul() call per node (the unbatched form), the same
+// chain through propagate(), and the world boxes through bounds()
+static int bench_kernels(){
+    const auto kernels = mat_kernels_t::supported();
+    for(const std::string &name : model_files(".mod")){
+        model_t m;
+        if(!m.load(name)) return 1;
+        m.compile();
+        const flat_nodes_t &flat = m.flat_nodes();
+        size_t n = flat.size();
+        std::vector<glm::mat4> local(n), world(n), model(n);
+        std::vector<aabb_t> box(n), bounds(n);
+        for(size_t i = 0; i < n; i++){
+            const HNode* node = flat.node[i];
+            local[i] = node->local_frame();
+            if(node->shape) box[i] = node->shape->local_bounds();
+        }
+        // enough passes for ~10M products per measurement
+        size_t passes = std::max<size_t>(1, 10000000 / n);
+        std::printf("%s: %zu nodes, %zu passes\n", name.c_str(), n, passes);
+        glm::mat4 moved(1.0f);
+        std::vector<glm::mat4> refWorld;
+        std::vector<aabb_t> refBounds;
+        for(const mat_kernels_t* k : kernels){
+            double mulNs = best_ns(passes, n, [&](size_t pass){
+                moved[3][0] = float(pass & 1); // the root moves every pass
+                for(size_t i = 0; i < n; i++){
+                    int p = flat.parent[i];
+                    k->mul(p < 0 ? moved : world[p], local[i], world[i]);
+                }
+            });
+            double chainNs = best_ns(passes, n, [&](size_t pass){
+                moved[3][0] = float(pass & 1);
+                k->propagate(moved, flat.parent.data(), local.data(), world.data(), nullptr, n);
+            });
+            for(size_t i = 0; i < n; i++) model[i] = glm::scale(world[i], flat.node[i]->scale);
+            double boundsNs = best_ns(passes, n, [&](size_t){
+                k->bounds(model.data(), box.data(), bounds.data(), nullptr, n);
+            });
+            if(k == kernels.front()){ refWorld = world; refBounds = bounds; }
+            float err = 0.0f;
+            for(size_t i = 0; i < n; i++){
+                for(int c = 0; c < 4; c++) err = std::max(err, glm::length(world[i][c] - refWorld[i][c]));
+                if(!box[i].empty()) err = std::max(err, glm::length(bounds[i].lo - refBounds[i].lo) + glm::length(bounds[i].hi - refBounds[i].hi));
+            }
+            std::printf("  %-7s mul %6.2f  propagate %6.2f  bounds %6.2f ns/node  (max diff vs scalar %g)\n",
+                        k->name, mulNs, chainNs, boundsNs, err);
+        }
+    }
+    return 0;
+}
+
+// The query as it was before parent links: bring every world matrix up to
+// date, then search the whole tree for target (O(N) per query)
+static bool dfs_frame(const HNode* node, const HNode* target, const flat_nodes_t &flat, glm::mat4 &out){
+    if(node == target){ out = flat.world[node->flat_index]; return true; }
+    for(auto &c : node->children) if(dfs_frame(c.get(), target, flat, out)) return true;
+    return false;
+}
+
+// get_world_frame_of (ancestor walk) against the full traversal, on random
+// nodes of a generated 100k-node model (or the count given)
+static int bench_query(size_t n){
+    model_t m;
+    make_model(m, n);
+    m.update_world();
+    const flat_nodes_t &flat = m.flat_nodes();
+    std::mt19937 rng(2);
+    std::vector<const HNode*> targets(1000);
+    for(auto &t : targets) t = flat.node[rng() % flat.size()];
+
+    auto &stats = render_stats_t::instance().cur;
+    size_t steps0 = stats.query_steps;
+    glm::mat4 frame;
+    float err = 0.0f;
+    double walkNs = best_ns(100, targets.size(), [&](size_t){
+        for(const HNode* t : targets) m.get_world_frame_of(t, frame);
+    });
+    double steps = double(stats.query_steps - steps0) / double(3 * 100 * targets.size());
+    double dfsNs = best_ns(1, targets.size(), [&](size_t){
+        for(const HNode* t : targets){
+            m.update_world();
+            dfs_frame(m.root.get(), t, flat, frame);
+        }
+    });
+    for(const HNode* t : targets){
+        glm::mat4 a, b;
+        m.get_world_frame_of(t, a);
+        dfs_frame(m.root.get(), t, flat, b);
+        for(int c = 0; c < 4; c++) err = std::max(err, glm::length(a[c] - b[c]));
+    }
+    std::printf("%zu nodes, %zu queries\n", flat.size(), targets.size());
+    std::printf("  ancestor walk  %10.1f ns/query  (%.1f steps)\n", walkNs, steps);
+    std::printf("  full DFS       %10.1f ns/query  (max diff %g)\n", dfsNs, err);
+    return 0;
+}
+
+// Room, robot and n level-4 spheres drawn the way the app draws a frame, at
+// 640x480 from a fixed camera, lit by L0/L1 and a toy light like the app's
+struct bench_scene_t {
+    model_t room, balls;
+    RobotArm robot;
+    light_list_t lights;
+    frame_uniforms_t frame;
+    render_queue_t queue;
+    GLuint texture = 0;
+    glm::mat4 view, proj;
+
+    explicit bench_scene_t(int spheres){
+        shader_cache_t::instance().preload();
+        glEnable(GL_DEPTH_TEST);
+        glViewport(0, 0, 640, 480);
+        geometry_cache_t &cache = geometry_cache_t::instance();
+        // floor, four walls, ceiling, platform: half extents, position
+        const glm::vec3 boxes[7][2] = {
+            { {12, 0.1f, 12}, {0, -0.1f, 0} }, { {12, 5, 0.05f}, {0, 2.5f, -12} }, { {12, 5, 0.05f}, {0, 2.5f, 12} },
+            { {0.05f, 5, 12}, {12, 2.5f, 0} }, { {0.05f, 5, 12}, {-12, 2.5f, 0} }, { {12, 0.05f, 12}, {0, 5, 0} },
+            { {1.2f, 0.1f, 1.2f}, {0, 0.1f, 0} } };
+        for(auto &b : boxes) room.add_shape(cache.box(0, b[0]))->translation = b[1];
+        std::mt19937 rng(3);
+        for(int i = 0; i < spheres; i++){
+            HNode* n = balls.add_shape(cache.sphere(4, 0.5f));
+            n->translation = glm::vec3(float(rng() % 200) * 0.1f - 10.0f, float(rng() % 40) * 0.1f + 0.5f, float(rng() % 200) * 0.1f - 10.0f);
+            n->scale = glm::vec3(0.3f);
+            n->color = glm::vec4(float(i % 7) / 7.0f, 0.5f, 0.8f, 1.0f);
+        }
+        robot.init();
+        lights.lights.resize(3);
+        lights.lights[0].position = glm::vec3(-3, 3, 3);
+        lights.lights[0].color = glm::vec3(1.0f, 0.95f, 0.9f);
+        lights.lights[1].position = glm::vec3(3, 3, -3);
+        lights.lights[1].color = glm::vec3(0.9f, 0.95f, 1.0f);
+        lights.lights[2].position = glm::vec3(0, 2, 0);
+        lights.lights[2].color = glm::vec3(1.0f, 0.9f, 0.7f);
+        unsigned char texels[4 * 4 * 3];
+        for(int i = 0; i < 48; i++) texels[i] = (unsigned char)(i * 5);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 4, 4, 0, GL_RGB, GL_UNSIGNED_BYTE, texels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        view = glm::lookAt(glm::vec3(6, 4, 8), glm::vec3(0, 1, 0), glm::vec3(0, 1, 0));
+        proj = glm::perspective(glm::radians(60.0f), 640.0f / 480.0f, 0.1f, 100.0f);
+    }
+    ~bench_scene_t(){ glDeleteTextures(1, &texture); }
+
+    // The three fixed lights, then n small bounded ones placed like the app's
+    // N key does (same seed)
+    void scatter(size_t n){
+        lights.lights.resize(3);
+        unsigned seed = 12345u;
+        auto rnd = [&](){ seed = seed * 1664525u + 1013904223u; return (seed >> 8) / float(1u << 24); };
+        for(size_t i = 0; i < n; i++){
+            point_light_t l;
+            l.position = glm::vec3(-11.0f + 22.0f * rnd(), 0.2f + 4.3f * rnd(), -11.0f + 22.0f * rnd());
+            l.color = glm::vec3(0.3f) + 0.7f * glm::vec3(rnd(), rnd(), rnd());
+            l.radius = 1.5f + 1.5f * rnd();
+            lights.lights.push_back(l);
+        }
+    }
+    // Every shape node gets the material half of a shader key
+    void set_material(uint32_t bits){
+        for(model_t* m : { &room, &balls, &robot.model }){
+            m->compile();
+            for(HNode* n : m->flat_nodes().node){
+                n->useTexture = (bits & SHADER_TEXTURED) != 0;
+                n->texture = n->useTexture ? texture : 0;
+                n->perPixel = (bits & SHADER_PER_PIXEL) != 0;
+            }
+        }
+    }
+    // Best of frames, after one warm-up frame; glFinish so the GPU work counts.
+    // The light mode key the frames used goes to modeKey.
+    double frame_ms(int frames, uint32_t* modeKey = nullptr){
+        double best = 1e30;
+        for(int f = 0; f <= frames; f++){
+            auto t0 = bench_clock::now();
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            frame_block_t fb;
+            fb.viewProj = proj * view;
+            uint32_t key = lights.build(view, proj, fb);
+            frame.upload(fb);
+            queue.clear();
+            room.enqueue(queue, fb.viewProj);
+            balls.enqueue(queue, fb.viewProj);
+            robot.enqueue(queue, fb.viewProj);
+            queue.submit(key);
+            glFinish();
+            if(f > 0) best = std::min(best, ms_since(t0));
+            if(modeKey) *modeKey = key;
+            render_stats_t::instance().end_frame();
+        }
+        return best;
+    }
+};
+
+// Frame time per shader permutation: each material key on every node, under
+// each light mode (no light on / only the unbounded ones / plus 8 bounded), with
+// and without rasterization (GL_RASTERIZER_DISCARD leaves the vertex work)
+static int bench_shaders(int spheres){
+    bench_scene_t scene(spheres);
+    const char* modes[3] = { "none", "global", "clustered" };
+    const char* materials[4] = { "plain", "textured", "per-pixel", "textured+per-pixel" };
+    std::printf("room + robot + %d spheres, 640x480, ms/frame (best of 5)\n", spheres);
+    std::printf("  %-10s %-19s %8s %12s\n", "lights", "material", "full", "vertex only");
+    for(int mode = 0; mode < 3; mode++){
+        scene.scatter(mode == 2 ? 8 : 0);
+        for(auto &l : scene.lights.lights) l.on = mode > 0;
+        for(uint32_t bits = 0; bits < 4; bits++){
+            scene.set_material(bits);
+            uint32_t key = 0;
+            double full = scene.frame_ms(5, &key);
+            glEnable(GL_RASTERIZER_DISCARD);
+            double vertex = scene.frame_ms(5);
+            glDisable(GL_RASTERIZER_DISCARD);
+            if((key & SHADER_LIGHTS_MASK) >> 2 != uint32_t(mode)) std::printf("  (light mode came out as %u)\n", (key & SHADER_LIGHTS_MASK) >> 2);
+            std::printf("  %-10s %-19s %8.2f %12.2f\n", modes[mode], materials[bits], full, vertex);
+        }
+    }
+    return 0;
+}
+
+// Frame time with the three fixed lights plus n scattered bounded ones
+// (8, 64 and 512 unless counts are given), room + robot + 200 spheres
+static int bench_lights(const std::vector<size_t> &counts){
+    bench_scene_t scene(200);
+    const auto &last = render_stats_t::instance().last;
+    std::printf("room + robot + 200 spheres, 640x480, 3 fixed lights + N (best of 5)\n");
+    std::printf("  %5s %10s %14s %16s %12s\n", "N", "ms/frame", "cluster build", "cluster entries", "longest list");
+    for(size_t n : counts){
+        scene.scatter(n);
+        double ms = scene.frame_ms(5);
+        std::printf("  %5zu %10.2f %11.3f ms %16zu %12zu\n", n, ms, last.cluster_ms, last.light_refs, last.light_max);
+    }
+    return 0;
+}
+
+// Startup mesh work with the disk cache off, cold (empty directory) and warm:
+// human.mod and car.mod plus 900 distinct level-4 spheres, cylinders and
+// cones in one acquire_all. Uses mesh_cache_bench/, removed afterwards.
+static int bench_meshcache(){
+    geometry_cache_t &cache = geometry_cache_t::instance();
+    std::vector<geometry_key_t> keys;
+    for(int i = 0; i < 300; i++){
+        float r = 0.1f + float(i) * 0.001f;
+        keys.push_back({ SPHERE_SHAPE, 4, glm::vec3(r, 0.0f, 0.0f) });
+        keys.push_back({ CYLINDER_SHAPE, 4, glm::vec3(r, 1.0f, 0.0f) });
+        keys.push_back({ CONE_SHAPE, 4, glm::vec3(r, 1.0f, 0.0f) });
+    }
+    const std::string dir = "mesh_cache_bench";
+    auto empty_dir = [&]{
+        if(DIR* d = opendir(dir.c_str())){
+            while(dirent* e = readdir(d)) if(e->d_name[0] != '.') std::remove((dir + "/" + e->d_name).c_str());
+            closedir(d);
+        }
+    };
+    // best of 3; the meshes are released between runs so every run misses
+    auto startup = [&](const std::string &disk, bool cold){
+        double best = 1e30;
+        for(int rep = 0; rep < 3; rep++){
+            if(cold) empty_dir();
+            cache.set_disk_directory(disk);
+            size_t loads = cache.disk_loads, saves = cache.disk_saves;
+            auto t0 = bench_clock::now();
+            model_t human, car;
+            bool ok = human.load("human.mod") && car.load("car.mod");
+            std::vector<std::shared_ptr<shape_t>> meshes = cache.acquire_all(keys);
+            best = std::min(best, ms_since(t0));
+            if(!ok) return -1.0;
+            if(rep == 2) std::printf("  %-5s %8.1f ms  (%zu read from disk, %zu written)\n", disk.empty() ? "off" : cold ? "cold" : "warm",
+                                     best, cache.disk_loads - loads, cache.disk_saves - saves);
+        }
+        return best;
+    };
+    std::printf("human.mod + car.mod + %zu level-4 meshes (best of 3)\n", keys.size());
+    bool ok = startup("", false) >= 0.0 && startup(dir, true) >= 0.0 && startup(dir, false) >= 0.0;
+    empty_dir();
+    std::remove(dir.c_str());
+    return ok ? 0 : 1;
+}
+
+int run_bench(int argc, char** argv){
+    std::string name = argc > 0 ? argv[0] : "";
+    if(name == "kernels") return bench_kernels();
+    if(name == "parse") return bench_parse();
+    if(name == "shaders") return bench_shaders(argc > 1 ? std::atoi(argv[1]) : 500);
+    if(name == "lights"){
+        std::vector<size_t> counts;
+        for(int i = 1; i < argc; i++) counts.push_back(std::strtoul(argv[i], nullptr, 10));
+        if(counts.empty()) counts = { 8, 64, 512 };
+        return bench_lights(counts);
+    }
+    if(name == "meshcache") return bench_meshcache();
+    if(name == "query") return bench_query(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000);
+    if(name == "load") return bench_load(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000);
+    std::fprintf(stderr, "usage: ./model --bench kernels | query [nodes] | shaders [spheres] | lights [N...] | meshcache | parse | load [nodes]\n");
+    return 1;
+}
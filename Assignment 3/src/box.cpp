@@ -1,52 +1,37 @@
 #include "box.hpp"
-// Build a triangulated box (two triangles per face) with simple UVs and colors.
-box_t::box_t(unsigned int lev, glm::vec3 half_extents): shape_t(lev), half(half_extents){
-    shapetype = BOX_SHAPE;
-    vertices.clear(); colors.clear(); normals.clear(); texcoords.clear();
-    glm::vec3 h = half;
+// Build a box with 4 vertices per face (flat normals, 0..1 UVs) and two indexed
+// triangles per face.
+mesh_data_t box_t::build(unsigned int /*lev: one tessellation*/, glm::vec3 half_extents){
+    mesh_data_t m;
+    glm::vec3 h = half_extents;
     glm::vec4 v[8] = {
         glm::vec4(-h.x,-h.y,-h.z,1), glm::vec4(h.x,-h.y,-h.z,1), glm::vec4(h.x,h.y,-h.z,1), glm::vec4(-h.x,h.y,-h.z,1),
         glm::vec4(-h.x,-h.y,h.z,1),  glm::vec4(h.x,-h.y,h.z,1),  glm::vec4(h.x,h.y,h.z,1),  glm::vec4(-h.x,h.y,h.z,1)
     };
-    int idx[] = {0,1,2, 0,2,3, 1,5,6, 1,6,2, 5,4,7, 5,7,6, 4,0,3, 4,3,7, 3,2,6, 3,6,7, 4,5,1, 4,1,0};
+    // Face corners a,b,c,d: triangles (a,b,c) and (a,c,d)
+    int quad[6][4] = { {0,1,2,3}, {1,5,6,2}, {5,4,7,6}, {4,0,3,7}, {3,2,6,7}, {4,5,1,0} };
     glm::vec3 nrm[6] = {
         glm::vec3(0,0,-1), glm::vec3(1,0,0), glm::vec3(0,0,1), glm::vec3(-1,0,0), glm::vec3(0,1,0), glm::vec3(0,-1,0)
     };
     // Simple per-face UVs (0..1 box)
-    auto pushTri = [&](int a, int b, int c, const glm::vec3 &n){
-        vertices.push_back(v[a]); vertices.push_back(v[b]); vertices.push_back(v[c]);
-        normals.push_back(n); normals.push_back(n); normals.push_back(n);
-        colors.push_back(glm::vec4(0.9f,0.6f,0.3f,1.0f));
-        colors.push_back(glm::vec4(0.9f,0.6f,0.3f,1.0f));
-        colors.push_back(glm::vec4(0.9f,0.6f,0.3f,1.0f));
-        texcoords.push_back(glm::vec2(0,0)); texcoords.push_back(glm::vec2(1,0)); texcoords.push_back(glm::vec2(1,1));
-    };
-    auto pushTri2 = [&](int a, int b, int c, const glm::vec3 &n){
-        vertices.push_back(v[a]); vertices.push_back(v[b]); vertices.push_back(v[c]);
-        normals.push_back(n); normals.push_back(n); normals.push_back(n);
-        colors.push_back(glm::vec4(0.9f,0.6f,0.3f,1.0f));
-        colors.push_back(glm::vec4(0.9f,0.6f,0.3f,1.0f));
-        colors.push_back(glm::vec4(0.9f,0.6f,0.3f,1.0f));
-        texcoords.push_back(glm::vec2(0,0)); texcoords.push_back(glm::vec2(1,1)); texcoords.push_back(glm::vec2(0,1));
-    };
-    // Expand manually to use push helpers per face
-    // -Z face
-    pushTri(0,1,2,nrm[0]); pushTri2(0,2,3,nrm[0]);
-    // +X face
-    pushTri(1,5,6,nrm[1]); pushTri2(1,6,2,nrm[1]);
-    // +Z face
-    pushTri(5,4,7,nrm[2]); pushTri2(5,7,6,nrm[2]);
-    // -X face
-    pushTri(4,0,3,nrm[3]); pushTri2(4,3,7,nrm[3]);
-    // +Y face
-    pushTri(3,2,6,nrm[4]); pushTri2(3,6,7,nrm[4]);
-    // -Y face
-    pushTri(4,5,1,nrm[5]); pushTri2(4,1,0,nrm[5]);
-    setup_buffers();
+    glm::vec2 uv[4] = { glm::vec2(0,0), glm::vec2(1,0), glm::vec2(1,1), glm::vec2(0,1) };
+    for(int f=0;f<6;f++){
+        GLuint base = (GLuint)m.vertices.size();
+        for(int k=0;k<4;k++){
+            m.vertices.push_back(v[quad[f][k]]);
+            m.normals.push_back(nrm[f]);
+            m.texcoords.push_back(uv[k]);
+        }
+        m.indices.push_back(base); m.indices.push_back(base+1); m.indices.push_back(base+2);
+        m.indices.push_back(base); m.indices.push_back(base+2); m.indices.push_back(base+3);
+    }
+    return m;
+}
+box_t::box_t(unsigned int lev, glm::vec3 half_extents): box_t(lev, half_extents, build(lev, half_extents)){}
+box_t::box_t(unsigned int lev, glm::vec3 half_extents, mesh_data_t &&prebuilt): shape_t(lev), half(half_extents){
+    shapetype = BOX_SHAPE;
+    adopt(std::move(prebuilt));
 }
 void box_t::draw(){
-    if(vao==0) return;
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES,0, (GLsizei) vertices.size());
-    glBindVertexArray(0);
+    draw_elements();
 }
@@ -1,27 +1,36 @@
 #include "cone.hpp"
+#include <algorithm>
 #include <glm/gtc/constants.hpp>
-// Build cone side + base as triangle fans.
-cone_t::cone_t(unsigned int lev, float r, float h): shape_t(lev), radius(r), height(h){
-    shapetype = CONE_SHAPE;
-    vertices.clear(); colors.clear();
+// Build cone side + base as triangle fans sharing one apex, one base center
+// and one rim ring.
+mesh_data_t cone_t::build(unsigned int lev, float r, float h){
+    mesh_data_t m;
+    unsigned int level = std::min(lev, 4u);
     int slices = 12 + 6*level;
-    glm::vec3 apex(0.0f, height/2.0f, 0.0f);
-    glm::vec3 center(0.0f, -height/2.0f, 0.0f);
+    glm::vec3 apex(0.0f, h/2.0f, 0.0f);
+    glm::vec3 center(0.0f, -h/2.0f, 0.0f);
+    const GLuint apexIdx = 0, centerIdx = 1, rim = 2;
+    m.vertices.push_back(glm::vec4(apex,1.0f));
+    m.vertices.push_back(glm::vec4(center,1.0f));
+    for(int i=0;i<slices;i++){
+        float a = 2.0f * glm::pi<float>() * float(i)/slices;
+        m.vertices.push_back(glm::vec4(r*cos(a), -h/2.0f, r*sin(a), 1.0f));
+    }
     for(int i=0;i<slices;i++){
-        float a1 = 2.0f * glm::pi<float>() * float(i)/slices;
-        float a2 = 2.0f * glm::pi<float>() * float(i+1)/slices;
-        glm::vec3 p1(radius*cos(a1), -height/2.0f, radius*sin(a1));
-        glm::vec3 p2(radius*cos(a2), -height/2.0f, radius*sin(a2));
-        vertices.push_back(glm::vec4(apex,1.0f)); vertices.push_back(glm::vec4(p2,1.0f)); vertices.push_back(glm::vec4(p1,1.0f));
-        for(int k=0;k<3;k++) colors.push_back(glm::vec4(0.9f,0.2f,0.2f,1.0f));
-        vertices.push_back(glm::vec4(center,1.0f)); vertices.push_back(glm::vec4(p1,1.0f)); vertices.push_back(glm::vec4(p2,1.0f));
-        for(int k=0;k<3;k++) colors.push_back(glm::vec4(0.3f,0.3f,0.3f,1.0f));
+        GLuint p1 = rim + i, p2 = rim + (i+1)%slices;
+        m.indices.push_back(apexIdx);   m.indices.push_back(p2); m.indices.push_back(p1);
+        m.indices.push_back(centerIdx); m.indices.push_back(p1); m.indices.push_back(p2);
     }
-    setup_buffers();
+    // no lighting normals or UVs: the placeholders setup_buffers() would fill in
+    m.normals.assign(m.vertices.size(), glm::vec3(0,1,0));
+    m.texcoords.assign(m.vertices.size(), glm::vec2(0.0f));
+    return m;
+}
+cone_t::cone_t(unsigned int lev, float r, float h): cone_t(lev, r, h, build(lev, r, h)){}
+cone_t::cone_t(unsigned int lev, float r, float h, mesh_data_t &&prebuilt): shape_t(lev), radius(r), height(h){
+    shapetype = CONE_SHAPE;
+    adopt(std::move(prebuilt));
 }
 void cone_t::draw(){
-    if(vao==0) return;
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES,0,(GLsizei)vertices.size());
-    glBindVertexArray(0);
+    draw_elements();
 }
@@ -1,63 +1,57 @@
 #include "cylinder.hpp"
+#include <algorithm>
 #include <glm/gtc/constants.hpp>
 // Generate cylinder triangles (sides + caps) with simple cylindrical + planar UVs.
-cylinder_t::cylinder_t(unsigned int lev, float r, float h): shape_t(lev), radius(r), height(h){
-    shapetype = CYLINDER_SHAPE;
-    vertices.clear(); colors.clear(); normals.clear(); texcoords.clear();
+// Side and caps keep separate rims (different normals/UVs); each rim vertex is
+// emitted once and shared by neighbouring triangles through the index buffer.
+mesh_data_t cylinder_t::build(unsigned int lev, float r, float h){
+    mesh_data_t m;
+    unsigned int level = std::min(lev, 4u);
     int slices = 12 + 6*level;
-    float halfh = height/2.0f;
-    for(int i=0;i<slices;i++){
-        float a1 = 2.0f * glm::pi<float>() * float(i)/slices;
-        float a2 = 2.0f * glm::pi<float>() * float(i+1)/slices;
-        glm::vec3 p1(radius*cos(a1), -halfh, radius*sin(a1));
-        glm::vec3 p2(radius*cos(a2), -halfh, radius*sin(a2));
-        glm::vec3 p3(radius*cos(a2), halfh, radius*sin(a2));
-        glm::vec3 p4(radius*cos(a1), halfh, radius*sin(a1));
+    float halfh = h/2.0f;
+    auto push = [&](const glm::vec3 &p, const glm::vec3 &n, const glm::vec2 &uv){
+        m.vertices.push_back(glm::vec4(p,1.0f)); m.normals.push_back(n); m.texcoords.push_back(uv);
+        return GLuint(m.vertices.size()-1);
+    };
+    // side: bottom/top rings with the seam column duplicated for UVs
+    const GLuint side = (GLuint)m.vertices.size();
+    for(int i=0;i<=slices;i++){
+        float a = 2.0f * glm::pi<float>() * float(i)/slices;
         // side normals outward per-vertex using angle center
-        glm::vec3 n1 = glm::normalize(glm::vec3(cos(a1),0.0f,sin(a1)));
-        glm::vec3 n2 = glm::normalize(glm::vec3(cos(a2),0.0f,sin(a2)));
-        // tri1
-        vertices.push_back(glm::vec4(p1,1.0f)); vertices.push_back(glm::vec4(p2,1.0f)); vertices.push_back(glm::vec4(p3,1.0f));
-        normals.push_back(n1); normals.push_back(n2); normals.push_back(n2);
+        glm::vec3 n = glm::vec3(cos(a),0.0f,sin(a));
         // UVs along circumference and height
-        texcoords.push_back(glm::vec2(float(i)/slices, 0.0f));
-        texcoords.push_back(glm::vec2(float(i+1)/slices, 0.0f));
-        texcoords.push_back(glm::vec2(float(i+1)/slices, 1.0f));
+        push(glm::vec3(r*cos(a), -halfh, r*sin(a)), n, glm::vec2(float(i)/slices, 0.0f));
+        push(glm::vec3(r*cos(a),  halfh, r*sin(a)), n, glm::vec2(float(i)/slices, 1.0f));
+    }
+    for(int i=0;i<slices;i++){
+        GLuint p1 = side + 2*i, p4 = p1 + 1, p2 = p1 + 2, p3 = p1 + 3;
+        // tri1
+        m.indices.push_back(p1); m.indices.push_back(p2); m.indices.push_back(p3);
         // tri2
-        vertices.push_back(glm::vec4(p1,1.0f)); vertices.push_back(glm::vec4(p3,1.0f)); vertices.push_back(glm::vec4(p4,1.0f));
-        normals.push_back(n1); normals.push_back(n2); normals.push_back(n1);
-        texcoords.push_back(glm::vec2(float(i)/slices, 0.0f));
-        texcoords.push_back(glm::vec2(float(i+1)/slices, 1.0f));
-        texcoords.push_back(glm::vec2(float(i)/slices, 1.0f));
-        for(int k=0;k<6;k++) colors.push_back(glm::vec4(0.2f,0.7f,0.3f,1.0f));
+        m.indices.push_back(p1); m.indices.push_back(p3); m.indices.push_back(p4);
+    }
+    // caps: center + rim, planar UVs (map circle to square roughly)
+    GLuint centerB = push(glm::vec3(0.0f,-halfh,0.0f), glm::vec3(0,-1,0), glm::vec2(0.5f,0.5f));
+    GLuint centerT = push(glm::vec3(0.0f, halfh,0.0f), glm::vec3(0, 1,0), glm::vec2(0.5f,0.5f));
+    const GLuint rimB = (GLuint)m.vertices.size();
+    for(int i=0;i<slices;i++){
+        float a = 2.0f * glm::pi<float>() * float(i)/slices;
+        glm::vec2 uv(0.5f + 0.5f*cos(a), 0.5f + 0.5f*sin(a));
+        push(glm::vec3(r*cos(a), -halfh, r*sin(a)), glm::vec3(0,-1,0), uv);
+        push(glm::vec3(r*cos(a),  halfh, r*sin(a)), glm::vec3(0, 1,0), uv);
     }
-    glm::vec3 centerB(0.0f,-halfh,0.0f), centerT(0.0f,halfh,0.0f);
     for(int i=0;i<slices;i++){
-        float a1 = 2.0f * glm::pi<float>() * float(i)/slices;
-        float a2 = 2.0f * glm::pi<float>() * float(i+1)/slices;
-        glm::vec3 p1(radius*cos(a1), -halfh, radius*sin(a1));
-        glm::vec3 p2(radius*cos(a2), -halfh, radius*sin(a2));
-        vertices.push_back(glm::vec4(centerB,1.0f)); vertices.push_back(glm::vec4(p2,1.0f)); vertices.push_back(glm::vec4(p1,1.0f));
-        for(int k=0;k<3;k++) colors.push_back(glm::vec4(0.2f,0.6f,0.9f,1.0f));
-        normals.push_back(glm::vec3(0,-1,0)); normals.push_back(glm::vec3(0,-1,0)); normals.push_back(glm::vec3(0,-1,0));
-        // planar UVs (map circle to square roughly)
-        texcoords.push_back(glm::vec2(0.5f,0.5f));
-        texcoords.push_back(glm::vec2(0.5f + 0.5f*cos(a2), 0.5f + 0.5f*sin(a2)));
-        texcoords.push_back(glm::vec2(0.5f + 0.5f*cos(a1), 0.5f + 0.5f*sin(a1)));
-        glm::vec3 q1(radius*cos(a1), halfh, radius*sin(a1));
-        glm::vec3 q2(radius*cos(a2), halfh, radius*sin(a2));
-        vertices.push_back(glm::vec4(centerT,1.0f)); vertices.push_back(glm::vec4(q1,1.0f)); vertices.push_back(glm::vec4(q2,1.0f));
-        for(int k=0;k<3;k++) colors.push_back(glm::vec4(0.2f,0.6f,0.9f,1.0f));
-        normals.push_back(glm::vec3(0,1,0)); normals.push_back(glm::vec3(0,1,0)); normals.push_back(glm::vec3(0,1,0));
-        texcoords.push_back(glm::vec2(0.5f,0.5f));
-        texcoords.push_back(glm::vec2(0.5f + 0.5f*cos(a1), 0.5f + 0.5f*sin(a1)));
-        texcoords.push_back(glm::vec2(0.5f + 0.5f*cos(a2), 0.5f + 0.5f*sin(a2)));
+        GLuint b1 = rimB + 2*i, b2 = rimB + 2*((i+1)%slices);
+        m.indices.push_back(centerB); m.indices.push_back(b2);   m.indices.push_back(b1);
+        m.indices.push_back(centerT); m.indices.push_back(b1+1); m.indices.push_back(b2+1);
     }
-    setup_buffers();
+    return m;
+}
+cylinder_t::cylinder_t(unsigned int lev, float r, float h): cylinder_t(lev, r, h, build(lev, r, h)){}
+cylinder_t::cylinder_t(unsigned int lev, float r, float h, mesh_data_t &&prebuilt): shape_t(lev), radius(r), height(h){
+    shapetype = CYLINDER_SHAPE;
+    adopt(std::move(prebuilt));
 }
 void cylinder_t::draw(){
-    if(vao==0) return;
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES,0,(GLsizei)vertices.size());
-    glBindVertexArray(0);
+    draw_elements();
 }
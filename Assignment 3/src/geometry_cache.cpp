@@ -0,0 +1,321 @@
+// -----------------------------------------------------------------------------
+// geometry_cache.cpp : Reference-counted sharing of tessellated primitives and
+// their disk cache.
+// Disk file: mesh_file_t, the arrays as in a .modb blob, then the vertices
+// interleaved in the format they were uploaded in, so a warm start copies them
+// into the arena without tessellating or packing. The file name is
+// the FNV-1a hash of the key and MESH_GENERATOR_VERSION; the header repeats
+// both, so a collision or a stale file is detected and regenerated.
+// -----------------------------------------------------------------------------
+#include "geometry_cache.hpp"
+#include "sphere.hpp"
+#include "box.hpp"
+#include "cylinder.hpp"
+#include "cone.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <sys/stat.h> // For mkdir
+
+struct mesh_file_t {
+    char magic[4];            // "MESH"
+    uint32_t version;         // MESH_GENERATOR_VERSION
+    uint32_t type, level;
+    float dims[3];
+    uint32_t vertex_count, index_count;
+    uint32_t packed_encoding;  // vertex_format_t of the interleaved copy
+    uint32_t packed_stride;
+};
+static_assert(sizeof(mesh_file_t) == 44, "mesh_file_t must have no padding");
+
+uint64_t mesh_blob_bytes(uint32_t vertexCount, uint32_t indexCount){
+    uint64_t n = uint64_t(vertexCount) * (sizeof(glm::vec4) + sizeof(glm::vec3) + sizeof(glm::vec2)) + uint64_t(indexCount) * sizeof(GLuint);
+    return (n + 7) & ~uint64_t(7);
+}
+
+// shape_t and mesh_data_t name their arrays alike
+template<class M> static void write_arrays(FILE* f, const M &s){
+    fwrite(s.vertices.data(), sizeof(glm::vec4), s.vertices.size(), f);
+    fwrite(s.normals.data(), sizeof(glm::vec3), s.normals.size(), f);
+    fwrite(s.texcoords.data(), sizeof(glm::vec2), s.texcoords.size(), f);
+    fwrite(s.indices.data(), sizeof(GLuint), s.indices.size(), f);
+    uint64_t used = s.vertices.size() * (sizeof(glm::vec4) + sizeof(glm::vec3) + sizeof(glm::vec2)) + s.indices.size() * sizeof(GLuint);
+    static const char pad[8] = {};
+    fwrite(pad, 1, size_t(mesh_blob_bytes(uint32_t(s.vertices.size()), uint32_t(s.indices.size())) - used), f);
+}
+
+void write_mesh_blob(FILE* f, const shape_t &s){
+    write_arrays(f, s);
+}
+
+bool read_mesh_blob(const char* p, uint32_t vertexCount, uint32_t indexCount, mesh_data_t &out){
+    const glm::vec4* v = (const glm::vec4*)p;  out.vertices.assign(v, v + vertexCount);  p += vertexCount * sizeof(glm::vec4);
+    const glm::vec3* n = (const glm::vec3*)p;  out.normals.assign(n, n + vertexCount);   p += vertexCount * sizeof(glm::vec3);
+    const glm::vec2* t = (const glm::vec2*)p;  out.texcoords.assign(t, t + vertexCount); p += vertexCount * sizeof(glm::vec2);
+    const GLuint* ix = (const GLuint*)p;       out.indices.assign(ix, ix + indexCount);
+    return std::none_of(out.indices.begin(), out.indices.end(), [&](GLuint k){ return k >= vertexCount; });
+}
+
+bool geometry_key_t::operator<(const geometry_key_t &o) const {
+    return std::make_tuple(int(type), level, dims.x, dims.y, dims.z)
+         < std::make_tuple(int(o.type), o.level, o.dims.x, o.dims.y, o.dims.z);
+}
+
+geometry_cache_t& geometry_cache_t::instance(){
+    static geometry_cache_t cache;
+    return cache;
+}
+
+// Tessellation for key (no GL calls)
+static mesh_data_t build(const geometry_key_t &key){
+    switch(key.type){
+        case SPHERE_SHAPE:   return sphere_t::build(key.level, key.dims.x);
+        case CYLINDER_SHAPE: return cylinder_t::build(key.level, key.dims.x, key.dims.y);
+        case CONE_SHAPE:     return cone_t::build(key.level, key.dims.x, key.dims.y);
+        case BOX_SHAPE:      return box_t::build(key.level, key.dims);
+    }
+    return mesh_data_t();
+}
+
+// Live mesh for key (counted as a hit), or nullptr
+std::shared_ptr<shape_t> geometry_cache_t::live(const geometry_key_t &key){
+    auto it = meshes.find(key);
+    if(it == meshes.end()) return nullptr;
+    auto s = it->second.lock();
+    if(s) count_hit(*s);
+    return s;
+}
+
+// CPU half of a miss (safe on worker threads): the key's disk file, or a new
+// tessellation, packed for upload and written to disk
+geometry_cache_t::source_t geometry_cache_t::prepare(const geometry_key_t &key, mesh_data_t &out) const {
+    if(load_disk(key, out)) return FROM_DISK;
+    out = build(key);
+    out.packed = shape_t::default_format->pack(out.vertices, out.normals, out.texcoords);
+    out.packed_format = shape_t::default_format;
+    return save_disk(key, out) ? BUILT_SAVED : BUILT;
+}
+
+// GL half of a miss (main thread): upload the arrays and remember the mesh.
+// Adopted arrays come from files and are not remembered: they must not stand
+// in for what the generator makes for key.
+std::shared_ptr<shape_t> geometry_cache_t::upload(const geometry_key_t &key, mesh_data_t &&m, source_t source){
+    std::shared_ptr<shape_t> s;
+    switch(key.type){
+        case SPHERE_SHAPE:   s = std::make_shared<sphere_t>(key.level, key.dims.x, std::move(m)); break;
+        case CYLINDER_SHAPE: s = std::make_shared<cylinder_t>(key.level, key.dims.x, key.dims.y, std::move(m)); break;
+        case CONE_SHAPE:     s = std::make_shared<cone_t>(key.level, key.dims.x, key.dims.y, std::move(m)); break;
+        case BOX_SHAPE:      s = std::make_shared<box_t>(key.level, key.dims, std::move(m)); break;
+    }
+    if(source == FROM_DISK) disk_loads++;
+    if(source == BUILT_SAVED) disk_saves++;
+    misses++;
+    if(source != ADOPTED) meshes[key] = s;
+    return s;
+}
+
+void geometry_cache_t::make_disk_dir(){
+    if(diskDir.empty() || diskDirMade) return;
+    mkdir(diskDir.c_str(), 0755);
+    diskDirMade = true;
+}
+
+// Look up a live mesh for key, or make (or adopt) a new one.
+std::shared_ptr<shape_t> geometry_cache_t::acquire(const geometry_key_t &key, mesh_data_t *prebuilt){
+    if(auto s = live(key)) return s;
+    auto t0 = std::chrono::steady_clock::now();
+    mesh_data_t m;
+    source_t source = ADOPTED;
+    if(prebuilt) m = std::move(*prebuilt);
+    else { make_disk_dir(); source = prepare(key, m); }
+    auto s = upload(key, std::move(m), source);
+    build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return s;
+}
+
+std::vector<std::shared_ptr<shape_t>> geometry_cache_t::acquire_all(const std::vector<geometry_key_t> &keys){
+    std::vector<std::shared_ptr<shape_t>> out(keys.size());
+    std::map<geometry_key_t, size_t> first; // missing key -> its slot in todo
+    std::vector<size_t> todo, repeats;
+    for(size_t i = 0; i < keys.size(); i++){
+        if((out[i] = live(keys[i]))) continue;
+        if(first.emplace(keys[i], todo.size()).second) todo.push_back(i);
+        else repeats.push_back(i);
+    }
+    if(todo.empty()) return out;
+
+    // workers (this thread included) take the next missing key until none is left.
+    // A key whose prepare() throws is marked and built again on this thread below.
+    auto t0 = std::chrono::steady_clock::now();
+    make_disk_dir();
+    std::vector<mesh_data_t> data(todo.size());
+    std::vector<source_t> source(todo.size());
+    std::vector<char> failed(todo.size(), 0);
+    std::atomic<size_t> next{0};
+    auto work = [&]{
+        for(size_t k; (k = next++) < todo.size(); ){
+            try { source[k] = prepare(keys[todo[k]], data[k]); }
+            catch(...) { failed[k] = 1; }
+        }
+    };
+    {
+        std::vector<std::thread> pool;
+        struct join_all_t {
+            std::vector<std::thread> &pool;
+            ~join_all_t(){ for(auto &t : pool) if(t.joinable()) t.join(); }
+        } join_all{pool};
+        size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), todo.size());
+        try {
+            for(size_t t = 1; t < threads; t++) pool.emplace_back(work);
+        } catch(const std::system_error&) {} // fewer workers; this thread takes the rest
+        work();
+    }
+    for(size_t k = 0; k < todo.size(); k++){
+        if(!failed[k]) continue;
+        data[k] = build(keys[todo[k]]);  // unpacked: the shape packs it on upload
+        source[k] = BUILT;
+    }
+
+    // one arena grow for the whole batch, then the uploads
+    vertex_arena_t &arena = vertex_arena_t::instance();
+    if(shape_t::default_format == &arena.format()){
+        size_t nv = 0, ni = 0;
+        for(auto &m : data) if(!m.indices.empty()){ nv += m.vertices.size(); ni += m.indices.size(); }
+        arena.reserve(GLuint(nv), GLuint(ni));
+    }
+    for(size_t k = 0; k < todo.size(); k++) out[todo[k]] = upload(keys[todo[k]], std::move(data[k]), source[k]);
+    for(size_t i : repeats){
+        out[i] = out[todo[first[keys[i]]]];
+        count_hit(*out[i]);
+    }
+    build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return out;
+}
+
+std::shared_ptr<shape_t> geometry_cache_t::sphere(unsigned int lev, float r){
+    return acquire({SPHERE_SHAPE, std::min(lev, 4u), glm::vec3(r, 0.0f, 0.0f)});
+}
+std::shared_ptr<shape_t> geometry_cache_t::cylinder(unsigned int lev, float r, float h){
+    return acquire({CYLINDER_SHAPE, std::min(lev, 4u), glm::vec3(r, h, 0.0f)});
+}
+std::shared_ptr<shape_t> geometry_cache_t::cone(unsigned int lev, float r, float h){
+    return acquire({CONE_SHAPE, std::min(lev, 4u), glm::vec3(r, h, 0.0f)});
+}
+std::shared_ptr<shape_t> geometry_cache_t::box(unsigned int lev, const glm::vec3 &half){
+    return acquire({BOX_SHAPE, std::min(lev, 4u), half});
+}
+
+std::string geometry_cache_t::disk_path(const geometry_key_t &key) const {
+    uint32_t fields[6] = { MESH_GENERATOR_VERSION, uint32_t(key.type), key.level };
+    memcpy(&fields[3], &key.dims[0], sizeof(float) * 3);
+    uint64_t h = 1469598103934665603ull;
+    for(size_t i = 0; i < sizeof(fields); i++){ h ^= ((const unsigned char*)fields)[i]; h *= 1099511628211ull; }
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.mesh", (unsigned long long)h);
+    return diskDir + name;
+}
+
+// Read the key's file straight into the arrays (false: missing, stale or damaged)
+bool geometry_cache_t::load_disk(const geometry_key_t &key, mesh_data_t &out) const {
+    if(diskDir.empty()) return false;
+    FILE* f = fopen(disk_path(key).c_str(), "rb");
+    if(!f) return false;
+    mesh_file_t h;
+    const vertex_format_t* fmt = shape_t::default_format;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, "MESH", 4) == 0 && h.version == MESH_GENERATOR_VERSION
+           && h.type == uint32_t(key.type) && h.level == key.level && memcmp(h.dims, &key.dims[0], sizeof(h.dims)) == 0;
+    // the counts are only trusted once the arrays they imply fit in the file
+    struct stat st;
+    ok = ok && fstat(fileno(f), &st) == 0 && sizeof(h) + mesh_blob_bytes(h.vertex_count, h.index_count) <= uint64_t(st.st_size);
+    if(ok){
+        uint32_t nv = h.vertex_count, ni = h.index_count;
+        out.vertices.resize(nv); out.normals.resize(nv); out.texcoords.resize(nv); out.indices.resize(ni);
+        ok = fread(out.vertices.data(), sizeof(glm::vec4), nv, f) == nv && fread(out.normals.data(), sizeof(glm::vec3), nv, f) == nv
+          && fread(out.texcoords.data(), sizeof(glm::vec2), nv, f) == nv && fread(out.indices.data(), sizeof(GLuint), ni, f) == ni
+          && std::none_of(out.indices.begin(), out.indices.end(), [&](GLuint k){ return k >= nv; });
+        // the interleaved copy is only of use in the layout shapes upload now
+        if(ok && h.packed_encoding == uint32_t(fmt->encoding) && h.packed_stride == uint32_t(fmt->stride)){
+            fseek(f, long(sizeof(h) + mesh_blob_bytes(nv, ni)), SEEK_SET);
+            out.packed.resize(size_t(nv) * fmt->stride);
+            if(fread(out.packed.data(), 1, out.packed.size(), f) == out.packed.size()) out.packed_format = fmt;
+            else out.packed.clear();
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Written under a temporary name and renamed, so a reader never sees half a file
+bool geometry_cache_t::save_disk(const geometry_key_t &key, const mesh_data_t &s) const {
+    if(diskDir.empty() || s.indices.empty() || !s.packed_format) return false;
+    std::string path = disk_path(key), tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if(!f) return false;
+    mesh_file_t h = {};
+    memcpy(h.magic, "MESH", 4);
+    h.version = MESH_GENERATOR_VERSION;
+    h.type = uint32_t(key.type); h.level = key.level;
+    memcpy(h.dims, &key.dims[0], sizeof(h.dims));
+    h.vertex_count = uint32_t(s.vertices.size()); h.index_count = uint32_t(s.indices.size());
+    h.packed_encoding = uint32_t(s.packed_format->encoding); h.packed_stride = uint32_t(s.packed_format->stride);
+    fwrite(&h, sizeof(h), 1, f);
+    write_arrays(f, s);
+    fwrite(s.packed.data(), 1, s.packed.size(), f);
+    bool ok = ferror(f) == 0;
+    if(fclose(f) != 0) ok = false;
+    if(ok && rename(tmp.c_str(), path.c_str()) == 0) return true;
+    remove(tmp.c_str());
+    return false;
+}
+
+std::shared_ptr<shape_t> geometry_cache_t::adopt(const geometry_key_t &key, mesh_data_t &&prebuilt){
+    return acquire(key, &prebuilt);
+}
+
+// Defaults mirror the constructor defaults of each primitive.
+bool geometry_cache_t::name_key(std::string_view type, unsigned int lev, geometry_key_t &key){
+    lev = std::min(lev, 4u);
+    if(type=="sphere")        key = {SPHERE_SHAPE, lev, glm::vec3(0.5f, 0.0f, 0.0f)};
+    else if(type=="box")      key = {BOX_SHAPE, lev, glm::vec3(0.5f)};
+    else if(type=="cylinder") key = {CYLINDER_SHAPE, lev, glm::vec3(0.4f, 1.0f, 0.0f)};
+    else if(type=="cone")     key = {CONE_SHAPE, lev, glm::vec3(0.4f, 1.0f, 0.0f)};
+    else return false;
+    return true;
+}
+
+std::shared_ptr<shape_t> geometry_cache_t::by_name(std::string_view type, unsigned int lev){
+    geometry_key_t key;
+    return name_key(type, lev, key) ? acquire(key) : nullptr;
+}
+
+size_t geometry_cache_t::live_meshes() const {
+    size_t n = 0;
+    for(auto &kv : meshes) if(!kv.second.expired()) n++;
+    return n;
+}
+
+void geometry_cache_t::print_stats() const {
+    std::cout << "Geometry cache: " << live_meshes() << " live meshes, "
+              << hits << " hits / " << misses << " misses, "
+              << (bytes_saved / 1024) << " KB of vertex data shared\n";
+    std::cout << "  meshes built in " << build_ms << " ms (" << disk_loads << " read from "
+              << (diskDir.empty() ? "disk cache [off]" : diskDir + "/") << ", " << disk_saves << " written)\n";
+    // Indexed meshes vs. what the same triangles cost through glDrawArrays
+    size_t unique = 0, drawn = 0, bytes = 0, unindexed = 0;
+    for(auto &kv : meshes){
+        auto s = kv.second.lock();
+        if(!s) continue;
+        unique += s->vertices.size(); drawn += s->drawn_vertex_count();
+        bytes += s->gpu_bytes(); unindexed += s->unindexed_bytes();
+    }
+    std::cout << "  indexed: " << unique << " vertices, " << (bytes / 1024) << " KB"
+              << " (glDrawArrays: " << drawn << " vertices, " << (unindexed / 1024) << " KB)\n";
+    const vertex_format_t* f = shape_t::default_format;
+    std::cout << "  vertex format: " << f->name << ", " << f->stride << " B/vertex in 1 VBO"
+              << " (separate vec4/vec4/vec3/vec2 VBOs: 52 B/vertex in 4)\n";
+}
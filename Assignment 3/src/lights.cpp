@@ -0,0 +1,122 @@
+// -----------------------------------------------------------------------------
+// lights.cpp : Cluster assignment of the point lights and texture-buffer upload.
+// Tile and slice indices must match the lookup in lighting.glsl:
+//   tile  = floor((ndc.xy * 0.5 + 0.5) * (TILES_X, TILES_Y))
+//   slice = floor(log(depth / near) * SLICES / log(far / near))
+// -----------------------------------------------------------------------------
+#include "lights.hpp"
+#include "render_stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+void light_list_t::attach(GLuint prog){
+    glUniform1i(glGetUniformLocation(prog, "lightData"), LIGHT_UNIT);
+    glUniform1i(glGetUniformLocation(prog, "clusterData"), CLUSTER_UNIT);
+    glUniform1i(glGetUniformLocation(prog, "lightIndex"), INDEX_UNIT);
+}
+
+// Re-specify buffer i (orphaning last frame's store) and bind it to its unit
+void light_list_t::upload(int i, GLenum format, const void *data, size_t bytes){
+    static const int units[3] = { LIGHT_UNIT, CLUSTER_UNIT, INDEX_UNIT };
+    if(!buffers[i]){
+        glGenBuffers(1, &buffers[i]);
+        glGenTextures(1, &textures[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, bytes, data, GL_STREAM_DRAW);
+    glActiveTexture(GL_TEXTURE0 + units[i]);
+    glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffers[i]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+uint32_t light_list_t::build(const glm::mat4 &view, const glm::mat4 &proj, frame_block_t &frame){
+    auto t0 = std::chrono::steady_clock::now();
+    // near/far planes of a glm::perspective matrix
+    float zn = proj[3][2] / (proj[2][2] - 1.0f), zf = proj[3][2] / (proj[2][2] + 1.0f);
+    float sliceScale = SLICES / std::log(zf / zn);
+    auto slice = [&](float d){ return std::min(std::max(int(std::floor(std::log(d / zn) * sliceScale)), 0), SLICES - 1); };
+    auto tile = [](float ndc, int n){ return std::min(int(std::floor((std::min(std::max(ndc, -1.0f), 1.0f) * 0.5f + 0.5f) * n)), n - 1); };
+
+    lightTexels.clear();
+    spans.clear();
+    std::vector<GLuint> &counts = clusterTexels; // count pass, then (first, count)
+    counts.assign(2 * CLUSTERS, 0);
+    // unbounded lights take the first texels (all the global loop reads)
+    std::vector<GLuint> unbounded;
+    for(const point_light_t &l : lights){
+        if(!l.on || l.radius > 0.0f) continue;
+        unbounded.push_back(GLuint(lightTexels.size() / 2));
+        lightTexels.push_back(glm::vec4(l.position, l.radius));
+        lightTexels.push_back(glm::vec4(l.color, 1.0f));
+    }
+    for(const point_light_t &l : lights){
+        if(!l.on || l.radius <= 0.0f) continue;
+        GLuint id = GLuint(lightTexels.size() / 2);
+        lightTexels.push_back(glm::vec4(l.position, l.radius));
+        lightTexels.push_back(glm::vec4(l.color, 1.0f));
+
+        // view-space box of the sphere, clipped to [near, far] in depth
+        glm::vec3 c = glm::vec3(view * glm::vec4(l.position, 1.0f));
+        float r = l.radius;
+        float d0 = std::max(-c.z - r, zn), d1 = std::min(-c.z + r, zf);
+        if(d0 > d1) continue;
+        // its screen rectangle: hull of the 8 projected corners (all in front)
+        glm::vec2 lo(1e30f), hi(-1e30f);
+        for(int k=0;k<8;k++){
+            glm::vec4 p = proj * glm::vec4(c.x + ((k & 1) ? r : -r), c.y + ((k & 2) ? r : -r), (k & 4) ? -d1 : -d0, 1.0f);
+            glm::vec2 ndc = glm::vec2(p) / p.w;
+            lo = glm::min(lo, ndc); hi = glm::max(hi, ndc);
+        }
+        if(hi.x < -1.0f || hi.y < -1.0f || lo.x > 1.0f || lo.y > 1.0f) continue;
+        span_t s{ id, glm::ivec3(tile(lo.x, TILES_X), tile(lo.y, TILES_Y), slice(d0)),
+                      glm::ivec3(tile(hi.x, TILES_X), tile(hi.y, TILES_Y), slice(d1)) };
+        spans.push_back(s);
+        for(int z=s.lo.z;z<=s.hi.z;z++)
+            for(int y=s.lo.y;y<=s.hi.y;y++)
+                for(int x=s.lo.x;x<=s.hi.x;x++) counts[2 * ((z * TILES_Y + y) * TILES_X + x) + 1]++;
+    }
+    GLuint active = GLuint(lightTexels.size() / 2);
+    if(lightTexels.empty()) lightTexels.assign(2, glm::vec4(0.0f));
+    upload(0, GL_RGBA32F, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4));
+
+    // Without a bounded light in view every cluster would list the same
+    // (unbounded) lights: the shader loops over just those instead
+    uint32_t mode = active == 0 ? SHADER_LIGHTS_NONE : spans.empty() ? SHADER_LIGHTS_GLOBAL : SHADER_LIGHTS_CLUSTERED;
+    GLuint first = 0, longest = 0;
+    if(mode == SHADER_LIGHTS_CLUSTERED){
+        // counting sort: unbounded lights head every list, then the bounded ones
+        for(int i=0;i<CLUSTERS;i++){
+            GLuint n = counts[2*i+1] + GLuint(unbounded.size());
+            counts[2*i] = first;
+            counts[2*i+1] = GLuint(unbounded.size()); // fill cursor
+            first += n;
+            longest = std::max(longest, n);
+        }
+        indexTexels.assign(first, 0);
+        if(!unbounded.empty())
+            for(int i=0;i<CLUSTERS;i++) std::copy(unbounded.begin(), unbounded.end(), indexTexels.begin() + clusterTexels[2*i]);
+        for(const span_t &s : spans)
+            for(int z=s.lo.z;z<=s.hi.z;z++)
+                for(int y=s.lo.y;y<=s.hi.y;y++)
+                    for(int x=s.lo.x;x<=s.hi.x;x++){
+                        GLuint *c = &clusterTexels[2 * ((z * TILES_Y + y) * TILES_X + x)];
+                        indexTexels[c[0] + c[1]++] = s.light;
+                    }
+        upload(1, GL_RG32UI, clusterTexels.data(), clusterTexels.size() * sizeof(GLuint));
+        upload(2, GL_R32UI, indexTexels.data(), indexTexels.size() * sizeof(GLuint));
+    }
+
+    frame.clusterDepth = glm::vec4(zn, sliceScale, 0.0f, 0.0f);
+    frame.clusterDims[0] = TILES_X; frame.clusterDims[1] = TILES_Y;
+    frame.clusterDims[2] = SLICES;
+    frame.clusterDims[3] = GLint(mode == SHADER_LIGHTS_GLOBAL ? unbounded.size() : active);
+
+    auto &stats = render_stats_t::instance().cur;
+    stats.lights = active; stats.clusters = CLUSTERS;
+    stats.light_refs = first; stats.light_max = longest;
+    stats.cluster_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return mode;
+}
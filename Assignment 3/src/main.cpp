@@ -1,9 +1,11 @@
 // -----------------------------------------------------------------------------
 // main.cpp
-// Application entry: sets up OpenGL/GLFW, loads shaders, builds scene, robot,
-// handles input (animation capture/playback + camera movement + robot control),
-// renders with simple multi-light Gouraud shading + optional texture mapping.
-// Cleanup here adds human-readable commentary; no functional changes.
+// Application entry: sets up OpenGL/GLFW, builds the room (baked per texture),
+// robot and loaded models (human/car baked), handles input (animation
+// capture/playback + camera movement + robot control + N for room lights).
+// Each frame fills the light list and clusters, enqueues every model into the
+// render queue (culled, sorted by shader/texture) and submits it.
+// ./model --convert and ./model --bench run headless and exit (bench.hpp).
 // -----------------------------------------------------------------------------
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -23,6 +25,14 @@
 #include <cmath>
 #include "animation.hpp"
 #include "line_strip.hpp"
+#include "geometry_cache.hpp"
+#include "render_stats.hpp"
+#include "simd_math.hpp"
+#include "vertex_arena.hpp"
+#include "frame_uniforms.hpp"
+#include "lights.hpp"
+#include "shader_cache.hpp"
+#include "bench.hpp"
 #include <sys/stat.h> // For mkdir
 
 
@@ -41,13 +51,12 @@ float g_keyframeSaveTime = 0.0f; // For auto-incrementing keyframe time
 double g_lastFrameTime = 0.0;    // For fixed-step timer
 
 // VISUALIZER GLOBALS
-std::unique_ptr<HNode> g_cameraPathSpline;   // The yellow smooth spline
-std::unique_ptr<HNode> g_cameraControlPoints; // Dots at each keyframe
-std::unique_ptr<HNode> g_cameraControlPolygon; // Straight lines connecting keys
+// Children of the root: yellow smooth spline, red control polygon, and a
+// group of dots at each keyframe (drawn in that order)
+model_t g_cameraPathVisuals;
 
 
 // Forward declarations
-static std::string readFile(const char* path);
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 bool saveFramebuffer(GLFWwindow* window, const std::string& filename);
 void applyAnimationState(float time); // Helper to set state
@@ -58,9 +67,7 @@ void applyAnimationState(float time); // Helper to set state
 // ----------------------------------------------------------------------------
 void updateCameraPathVisuals() {
     // Clear old visuals
-    g_cameraPathSpline = nullptr;
-    g_cameraControlPoints = nullptr;
-    g_cameraControlPolygon = nullptr;
+    g_cameraPathVisuals.clear();
 
     if (gAnimationSystem.cameraKeys.size() < 2) {
         return; // Not enough points to draw
@@ -79,20 +86,13 @@ void updateCameraPathVisuals() {
         polygonPoints.push_back(key.eye);
 
         // Add a small sphere at the control point
-        auto sphereShape = std::make_unique<sphere_t>(1); // Low-poly sphere
-        auto sphereNode = std::make_unique<HNode>(std::move(sphereShape));
-        sphereNode->translate = glm::translate(glm::mat4(1.0f), key.eye);
-        sphereNode->scale = glm::scale(glm::mat4(1.0f), glm::vec3(0.05f)); // Small dot
+        auto sphereNode = std::make_unique<HNode>();
+        sphereNode->translation = key.eye;
+        sphereNode->scale = glm::vec3(0.05f); // Small dot
         sphereNode->color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f); // Bright red
-        if(sphereNode->shape){ for(auto &c: sphereNode->shape->colors) c = sphereNode->color; glBindBuffer(GL_ARRAY_BUFFER, sphereNode->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, sphereNode->shape->colors.size()*sizeof(glm::vec4), sphereNode->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);}
-        controlPointsNode->children.push_back(std::move(sphereNode));
+        sphereNode->shape = geometry_cache_t::instance().sphere(1, 0.5f); // Low-poly sphere, shared by all dots
+        controlPointsNode->add_child(std::move(sphereNode));
     }
-    // Create the polygon line strip
-    auto polygonShape = std::make_unique<line_strip_t>(polygonPoints, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)); // Red
-    g_cameraControlPolygon = std::make_unique<HNode>(std::move(polygonShape));
-    // Store the group of spheres
-    g_cameraControlPoints = std::move(controlPointsNode);
-
 
     // Create Smooth Spline
     for (int j = 0; j <= TESS_LEVEL; ++j) {
@@ -100,32 +100,23 @@ void updateCameraPathVisuals() {
         splinePoints.push_back(AnimationSystem::bezier(gAnimationSystem.cameraKeys, t));
     }
     
-    auto splineShape = std::make_unique<line_strip_t>(splinePoints, glm::vec4(1.0f, 1.0f, 0.0f, 1.0f)); // Bright yellow
-    g_cameraPathSpline = std::make_unique<HNode>(std::move(splineShape));
+    HNode* spline = g_cameraPathVisuals.add_shape(std::make_shared<line_strip_t>(splinePoints));
+    spline->color = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f); // Bright yellow
+
+    // Create the polygon line strip
+    HNode* polygon = g_cameraPathVisuals.add_shape(std::make_shared<line_strip_t>(polygonPoints));
+    polygon->color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f); // Red
+    // Store the group of spheres
+    g_cameraPathVisuals.root->add_child(std::move(controlPointsNode));
 
     std::cout << "updateCameraPathVisuals: Updated all 3 visualizers (Bézier).\n";
 }
 
-// Recursive helper to accumulate transformed vertex bounds
-static void compute_aabb_node(const HNode* node, const glm::mat4 &parentWorld,
-                              glm::vec3 &minv, glm::vec3 &maxv){
-    if(!node) return;
-    glm::mat4 world = parentWorld * node->translate * node->rotate;
-    glm::mat4 M = world * node->scale;
-    if(node->shape){
-        for(const auto &v4 : node->shape->vertices){
-            glm::vec3 p = glm::vec3(M * v4);
-            minv = glm::min(minv, p);
-            maxv = glm::max(maxv, p);
-        }
-    }
-    for(const auto &c : node->children) compute_aabb_node(c.get(), world, minv, maxv);
-}
+// World-space bounds of a model placed at world (used to ground models on the floor)
 static bool compute_aabb(const model_t &m, const glm::mat4 &world, glm::vec3 &minv, glm::vec3 &maxv){
     if(!m.root) return false;
-    minv = glm::vec3(std::numeric_limits<float>::infinity());
-    maxv = glm::vec3(-std::numeric_limits<float>::infinity());
-    compute_aabb_node(m.root.get(), world, minv, maxv);
+    aabb_t b = m.world_bounds(world);
+    minv = b.lo; maxv = b.hi;
     auto finite3 = [](const glm::vec3 &v){ return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z); };
     if(!finite3(minv) || !finite3(maxv)) return false;
     return true;
@@ -136,16 +127,34 @@ enum AppMode { MODELLER, INSPECT, ROBOT };
 enum EditMode { EDIT_NONE, EDIT_ROTATE, EDIT_TRANSLATE, EDIT_SCALE };
 enum CameraMode { CAM_SCENE = 1, CAM_FOLLOW = 2 };
 
-struct Lights {
-    bool l0On = true;
-    bool l1On = true;
-    bool toyOn = true;
-    glm::vec3 l0Pos = glm::vec3(-3, 3, 3);
-    glm::vec3 l1Pos = glm::vec3( 3, 3,-3);
-    glm::vec3 l0Col = glm::vec3(1.0, 0.95, 0.9);
-    glm::vec3 l1Col = glm::vec3(0.9, 0.95, 1.0);
-    glm::vec3 toyCol= glm::vec3(1.0, 0.9, 0.7);
-} lights;
+// Scene light list: L0/L1 and the toy light on the hand tip (unbounded), then
+// any scattered room lights (N cycles their count)
+enum { LIGHT_0, LIGHT_1, LIGHT_TOY, FIXED_LIGHTS };
+light_list_t lights;
+
+static void init_lights(){
+    lights.lights.resize(FIXED_LIGHTS);
+    lights.lights[LIGHT_0].position = glm::vec3(-3, 3, 3);
+    lights.lights[LIGHT_0].color = glm::vec3(1.0, 0.95, 0.9);
+    lights.lights[LIGHT_1].position = glm::vec3( 3, 3,-3);
+    lights.lights[LIGHT_1].color = glm::vec3(0.9, 0.95, 1.0);
+    lights.lights[LIGHT_TOY].color = glm::vec3(1.0, 0.9, 0.7); // position follows the hand
+}
+
+// Replace the scattered lights with n small colored ones inside the room
+// (fixed seed, so keyframed on/off states stay attached to the same lights)
+static void scatter_room_lights(size_t n){
+    lights.lights.resize(FIXED_LIGHTS);
+    unsigned seed = 12345u;
+    auto rnd = [&](){ seed = seed * 1664525u + 1013904223u; return (seed >> 8) / float(1u << 24); };
+    for(size_t i=0;i<n;i++){
+        point_light_t l;
+        l.position = glm::vec3(-11.0f + 22.0f * rnd(), 0.2f + 4.3f * rnd(), -11.0f + 22.0f * rnd());
+        l.color = glm::vec3(0.3f) + 0.7f * glm::vec3(rnd(), rnd(), rnd());
+        l.radius = 1.5f + 1.5f * rnd();
+        lights.lights.push_back(l);
+    }
+}
 
 struct AppState {
     AppMode appMode = ROBOT;     // Start in robot mode
@@ -156,7 +165,8 @@ struct AppState {
     CameraMode camMode = CAM_SCENE;
     // textures
     GLuint texFloor=0, texWall=0, texPlatform=0, texMetal10=0, texWooden=0;
-    GLint useTexLoc=-1, samplerLoc=-1;
+    render_queue_t queue; // draw packets of the current frame
+    frame_uniforms_t frame; // Frame uniform block (ViewProj + cluster grid)
     // Additional models placed around the robot
     model_t humanModel;
     model_t carModel;
@@ -192,27 +202,6 @@ static GLuint makeTexture(const char* path){
     glBindTexture(GL_TEXTURE_2D,0);
     return t;
 }
-// Compile GLSL shader from file, abort on failure
-static GLuint compileShader(const char* path, GLenum type){
-    std::string src = readFile(path);
-    const char* c = src.c_str();
-    GLuint sh = glCreateShader(type);
-    glShaderSource(sh,1,&c,nullptr);
-    glCompileShader(sh);
-    GLint ok; glGetShaderiv(sh,GL_COMPILE_STATUS,&ok);
-    if(!ok){ char log[1024]; glGetShaderInfoLog(sh,1024,nullptr,log); std::cerr<<log<<std::endl; exit(1);} 
-    return sh;
-}
-// Link basic vertex/fragment program
-static GLuint makeProgram(){
-    GLuint vs = compileShader("shaders/basic.vert", GL_VERTEX_SHADER);
-    GLuint fs = compileShader("shaders/basic.frag", GL_FRAGMENT_SHADER);
-    GLuint p = glCreateProgram();
-    glAttachShader(p,vs); glAttachShader(p,fs); glLinkProgram(p);
-    GLint ok; glGetProgramiv(p,GL_LINK_STATUS,&ok);
-    if(!ok){ char log[1024]; glGetProgramInfoLog(p,1024,nullptr,log); std::cerr<<log<<std::endl; exit(1); }
-    return p;
-}
 // Debug print of current edit/camera mode (legacy modeller functionality)
 static void printMode(){
     std::cout << "Mode: ";
@@ -361,9 +350,7 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
         SceneKey sk = state.robot.getPose();
         sk.t = g_keyframeSaveTime;
         // Add scene data
-        sk.light0On   = lights.l0On ? 1.0f : 0.0f;
-        sk.light1On   = lights.l1On ? 1.0f : 0.0f;
-        sk.toyLightOn = lights.toyOn ? 1.0f : 0.0f;
+        for (const point_light_t &l : lights.lights) sk.lightOn.push_back(l.on ? 1.0f : 0.0f);
         sk.carPos = glm::vec3(state.carWorld[3]); 
         sk.carYaw = 0.0f;
         gAnimationSystem.sceneKeys.push_back(sk);
@@ -435,9 +422,17 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 
     // --- ORIGINAL ROBOT/SCENE CONTROLS ---
     if(key==GLFW_KEY_V){ state.camMode = (state.camMode==CAM_SCENE? CAM_FOLLOW: CAM_SCENE); std::cout<<"Camera: "<<(state.camMode==CAM_SCENE?"Scene":"Follow")<<"\n"; return; }
-    if(key==GLFW_KEY_8){ lights.l0On = !lights.l0On; std::cout<<"Light 0: "<<(lights.l0On?"On":"Off")<<"\n"; return; }
-    if(key==GLFW_KEY_9){ lights.l1On = !lights.l1On; std::cout<<"Light 1: "<<(lights.l1On?"On":"Off")<<"\n"; return; }
-    if(key==GLFW_KEY_0){ lights.toyOn = !lights.toyOn; std::cout<<"Toy Light: "<<(lights.toyOn?"On":"Off")<<"\n"; return; }
+    if(key==GLFW_KEY_8){ bool &on = lights.lights[LIGHT_0].on; on = !on; std::cout<<"Light 0: "<<(on?"On":"Off")<<"\n"; return; }
+    if(key==GLFW_KEY_9){ bool &on = lights.lights[LIGHT_1].on; on = !on; std::cout<<"Light 1: "<<(on?"On":"Off")<<"\n"; return; }
+    if(key==GLFW_KEY_0){ bool &on = lights.lights[LIGHT_TOY].on; on = !on; std::cout<<"Toy Light: "<<(on?"On":"Off")<<"\n"; return; }
+    if(key==GLFW_KEY_N){
+        static const size_t counts[] = { 0, 8, 64, 512 };
+        size_t cur = lights.lights.size() - FIXED_LIGHTS, next = 0;
+        for(size_t c : counts) if(c > cur){ next = c; break; }
+        scatter_room_lights(next);
+        std::cout<<"Room lights: "<<next<<"\n";
+        return;
+    }
     float angleStep = 0.1f, gripStep = 0.02f;
     if(key==GLFW_KEY_UP)    { state.robot.lowerArmRotX += angleStep; state.robot.updateJoints(); return; }
     if(key==GLFW_KEY_DOWN)  { state.robot.lowerArmRotX -= angleStep; state.robot.updateJoints(); return; }
@@ -456,6 +451,16 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
     if(key==GLFW_KEY_O) { state.robot.gripperOpen = std::min(1.0f, state.robot.gripperOpen + gripStep); state.robot.updateJoints(); return; }
     if(key==GLFW_KEY_B) { state.robot.gripperOpen = std::max(0.0f, state.robot.gripperOpen - gripStep); state.robot.updateJoints(); return; }
 
+    // 'G' = Print render/geometry statistics for the last frame
+    if(key==GLFW_KEY_G) {
+        render_stats_t::instance().print();
+        geometry_cache_t::instance().print_stats();
+        shader_cache_t::instance().print_stats();
+        vertex_arena_t::instance().print_stats();
+        std::cout << "Matrix kernels: " << mat_kernels_t::active().name << "\n";
+        return;
+    }
+
     // Help
     if(key==GLFW_KEY_H) {
         std::cout << "\n=== ANIMATION CONTROLS ===\n";
@@ -480,7 +485,9 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
         std::cout << "Q/E: Hand pitch, Z/Y: Hand yaw, 1/2: Hand roll\n";
         std::cout << "O/B: Open/Close gripper\n";
         std::cout << "8/9/0: Toggle Lights\n";
-        std::cout << "V: Toggle Camera (Scene/Follow)\n\n";
+        std::cout << "N: Scatter 0/8/64/512 point lights in the room\n";
+        std::cout << "V: Toggle Camera (Scene/Follow)\n";
+        std::cout << "G: Print render statistics\n\n";
         return;
     }
 }
@@ -493,51 +500,40 @@ static void build_scene(){
     state.texPlatform = makeTexture("images/metal.bmp");
     state.texMetal10  = makeTexture("images/metal10.bmp");
     state.texWooden   = makeTexture("images/wooden.bmp");
+    // Textured surfaces use a white base color so the texture is modulated only by lighting
+    // Room surfaces are large boxes with few vertices: they are lit per pixel
+    // so small point lights show up in the middle of a face
     auto setTextureWhite = [](HNode* n, GLuint tex){
         n->texture = tex; n->useTexture = (tex!=0);
-        if(n->shape){
-            auto &cols = n->shape->colors; for(auto &c : cols) c = glm::vec4(1.0f);
-            glBindBuffer(GL_ARRAY_BUFFER, n->shape->vbo[1]);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data());
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-        }
+        n->color = glm::vec4(1.0f);
+        n->perPixel = true;
     };
-    { auto b = std::make_unique<box_t>(0, glm::vec3(12,0.1f,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f, 0.0f)); setTextureWhite(n, state.texFloor); }
-    { auto b = std::make_unique<box_t>(0, glm::vec3(12,5,0.05f)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.5f, -12.0f)); setTextureWhite(n, state.texWall); }
-    { auto b = std::make_unique<box_t>(0, glm::vec3(12,5,0.05f)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 2.5f, 12.0f)); setTextureWhite(n, state.texWall); }
-    { auto b = std::make_unique<box_t>(0, glm::vec3(0.05f,5,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(12.0f, 2.5f, 0.0f)); setTextureWhite(n, state.texWall); }
-    { auto b = std::make_unique<box_t>(0, glm::vec3(0.05f,5,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(-12.0f, 2.5f, 0.0f)); setTextureWhite(n, state.texWall); }
-    { auto b = std::make_unique<box_t>(0, glm::vec3(12,0.05f,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 5.0f, 0.0f)); setTextureWhite(n, state.texWall); }
-    { auto b = std::make_unique<box_t>(0, glm::vec3(1.2f, 0.1f, 1.2f)); HNode* n = state.scene.add_shape(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.1f, 0.0f)); setTextureWhite(n, state.texPlatform); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(12,0.1f,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(0.0f, -0.1f, 0.0f); setTextureWhite(n, state.texFloor); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(12,5,0.05f)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(0.0f, 2.5f, -12.0f); setTextureWhite(n, state.texWall); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(12,5,0.05f)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(0.0f, 2.5f, 12.0f); setTextureWhite(n, state.texWall); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(0.05f,5,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(12.0f, 2.5f, 0.0f); setTextureWhite(n, state.texWall); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(0.05f,5,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(-12.0f, 2.5f, 0.0f); setTextureWhite(n, state.texWall); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(12,0.05f,12)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(0.0f, 5.0f, 0.0f); setTextureWhite(n, state.texWall); }
+    { auto b = geometry_cache_t::instance().box(0, glm::vec3(1.2f, 0.1f, 1.2f)); HNode* n = state.scene.add_shape(std::move(b)); n->translation = glm::vec3(0.0f, 0.1f, 0.0f); setTextureWhite(n, state.texPlatform); }
     {
         auto tableGroup = std::make_unique<HNode>();
-        tableGroup->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -6.0f));
+        tableGroup->translation = glm::vec3(0.0f, 0.0f, -6.0f);
         HNode* tbl = tableGroup.get();
         const float topHalfX = 0.9f, topHalfY = 0.04f, topHalfZ = 0.6f;
         const float legHalfX = 0.05f, legHalfY = 0.36f, legHalfZ = 0.05f;
         const float legY = legHalfY; const float topY = 2*legHalfY + topHalfY;
         const float margin = 0.05f; const float offX = topHalfX - legHalfX - margin;
         const float offZ = topHalfZ - legHalfZ - margin;
-        { auto b = std::make_unique<box_t>(0, glm::vec3(topHalfX, topHalfY, topHalfZ)); auto n = std::make_unique<HNode>(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, topY, 0.0f)); setTextureWhite(n.get(), state.texWooden); tbl->children.push_back(std::move(n)); }
-        auto addLeg = [&](float x, float z){ auto b = std::make_unique<box_t>(0, glm::vec3(legHalfX, legHalfY, legHalfZ)); auto n = std::make_unique<HNode>(std::move(b)); n->translate = glm::translate(glm::mat4(1.0f), glm::vec3(x, legY, z)); setTextureWhite(n.get(), state.texWooden); tbl->children.push_back(std::move(n)); };
+        { auto b = geometry_cache_t::instance().box(0, glm::vec3(topHalfX, topHalfY, topHalfZ)); auto n = std::make_unique<HNode>(std::move(b)); n->translation = glm::vec3(0.0f, topY, 0.0f); setTextureWhite(n.get(), state.texWooden); tbl->add_child(std::move(n)); }
+        auto addLeg = [&](float x, float z){ auto b = geometry_cache_t::instance().box(0, glm::vec3(legHalfX, legHalfY, legHalfZ)); auto n = std::make_unique<HNode>(std::move(b)); n->translation = glm::vec3(x, legY, z); setTextureWhite(n.get(), state.texWooden); tbl->add_child(std::move(n)); };
         addLeg( offX,  offZ); addLeg(-offX,  offZ); addLeg( offX, -offZ); addLeg(-offX, -offZ);
-        state.scene.root->children.push_back(std::move(tableGroup));
+        state.scene.root->add_child(std::move(tableGroup));
     }
+    // the room never moves: floor, walls, ceiling, platform and table merge per texture
+    state.scene.root->set_bake(true);
 }
 
 
-// Utility: read entire file into string
-static std::string readFile(const char* path) {
-    FILE* f = fopen(path, "rb");
-    if (!f) return "";
-    fseek(f, 0, SEEK_END);
-    size_t sz = ftell(f);
-    rewind(f);
-    std::string s(sz, '\0');
-    fread(&s[0], 1, sz, f);
-    fclose(f);
-    return s;
-}
 
 
 // Apply interpolated animation state (camera & robot + lights + car position)
@@ -561,9 +557,9 @@ void applyAnimationState(float time) {
     if (!gAnimationSystem.sceneKeys.empty() && time >= gAnimationSystem.sceneKeys.front().t) 
     {
         state.robot.setPose(currentState.scene); 
-        lights.l0On = (currentState.scene.light0On >= 0.5f);
-        lights.l1On = (currentState.scene.light1On >= 0.5f);
-        lights.toyOn = (currentState.scene.toyLightOn >= 0.5f);
+        const std::vector<float> &on = currentState.scene.lightOn;
+        for (size_t i = 0; i < on.size() && i < lights.lights.size(); ++i)
+            lights.lights[i].on = (on[i] >= 0.5f);
 
         // Re-build the car's world matrix
         glm::mat4 originalCarTransform = glm::translate(glm::mat4(1.0f), glm::vec3(1.8f, 0.0f, -1.0f)) 
@@ -575,39 +571,58 @@ void applyAnimationState(float time) {
     }
 }
 
-int main(){
+int main(int argc, char** argv){
     if(!glfwInit()){ std::cerr<<"GLFW init failed\n"; return -1; }
+    // ./model --convert <in> <out> [--embed]: .mod <-> .modb (files in models/)
+    bool convert = argc >= 4 && std::string(argv[1]) == "--convert";
+    // ./model --bench <name> [args]: timing runs (bench.hpp)
+    bool bench = argc >= 3 && std::string(argv[1]) == "--bench";
+    if(convert || bench) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // primitives still need a context
     GLFWwindow* win = glfwCreateWindow(1024,768,"Hierarchical Modeller",NULL,NULL);
     if(!win){ std::cerr<<"Window create failed\n"; glfwTerminate(); return -1; }
     glfwMakeContextCurrent(win);
     glewExperimental = GL_TRUE; if(glewInit()!=GLEW_OK){ std::cerr<<"GLEW init failed\n"; return -1; }
     glfwSetInputMode(win, GLFW_STICKY_KEYS, GLFW_TRUE);
+    if(convert){
+        model_t m;
+        bool ok = m.load(argv[2]);
+        // load() hangs the file's top node under a fresh root: save that node
+        // so a conversion does not add a level
+        if(ok && m.root->children.size() == 1){
+            m.root = std::move(m.root->children[0]);
+            m.root->parent = nullptr;
+        }
+        ok = ok && m.save(argv[3], argc > 4 && std::string(argv[4]) == "--embed");
+        glfwTerminate();
+        return ok ? 0 : 1;
+    }
+    if(bench){
+        int rc = run_bench(argc - 2, argv + 2);
+        glfwTerminate();
+        return rc;
+    }
 
-    GLuint prog = makeProgram();
-    glUseProgram(prog);
-    GLuint mvpLoc   = glGetUniformLocation(prog,"MVP");
-    GLuint modelLoc = glGetUniformLocation(prog,"Model");
-    state.useTexLoc = glGetUniformLocation(prog,"useTexture");
-    state.samplerLoc= glGetUniformLocation(prog,"tex");
-    glUniform1i(state.samplerLoc, 0);
+    // every shader permutation, compiled once (materials pick theirs per draw)
+    shader_cache_t::instance().preload();
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_LINE_SMOOTH); // Make lines look nicer
 
     // scene
     build_scene();
+    init_lights();
     std::cout << "Scene built with " << state.scene.root->children.size() << " objects.\n";
     
     // robot
     state.robot.init();
-    state.robot.model.root->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.35f, 0.0f));
+    state.robot.model.root->set_translation(glm::vec3(0.0f, 0.35f, 0.0f));
     //robot texturing
-    if(state.texMetal10!=0 && state.robot.base){ state.robot.base->texture = state.texMetal10; state.robot.base->useTexture = true; if(state.robot.base->shape){ auto &cols = state.robot.base->shape->colors; for(auto &c: cols) c = glm::vec4(1.0f); glBindBuffer(GL_ARRAY_BUFFER, state.robot.base->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data()); glBindBuffer(GL_ARRAY_BUFFER, 0); } }
+    if(state.texMetal10!=0 && state.robot.base){ state.robot.base->texture = state.texMetal10; state.robot.base->useTexture = true; state.robot.base->color = glm::vec4(1.0f); }
     GLuint texTechno = makeTexture("images/techno.bmp");
-    if(texTechno!=0){ if(state.robot.lowerArmGeom){ state.robot.lowerArmGeom->texture = texTechno; state.robot.lowerArmGeom->useTexture = true; if(state.robot.lowerArmGeom->shape){ auto &cols = state.robot.lowerArmGeom->shape->colors; for(auto &c: cols) c = glm::vec4(1.0f); glBindBuffer(GL_ARRAY_BUFFER, state.robot.lowerArmGeom->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data()); glBindBuffer(GL_ARRAY_BUFFER, 0); } } if(state.robot.upperArmGeom){ state.robot.upperArmGeom->texture = texTechno; state.robot.upperArmGeom->useTexture = true; if(state.robot.upperArmGeom->shape){ auto &cols = state.robot.upperArmGeom->shape->colors; for(auto &c: cols) c = glm::vec4(1.0f); glBindBuffer(GL_ARRAY_BUFFER, state.robot.upperArmGeom->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data()); glBindBuffer(GL_ARRAY_BUFFER, 0); } } }
+    if(texTechno!=0){ if(state.robot.lowerArmGeom){ state.robot.lowerArmGeom->texture = texTechno; state.robot.lowerArmGeom->useTexture = true; state.robot.lowerArmGeom->color = glm::vec4(1.0f); } if(state.robot.upperArmGeom){ state.robot.upperArmGeom->texture = texTechno; state.robot.upperArmGeom->useTexture = true; state.robot.upperArmGeom->color = glm::vec4(1.0f); } }
     GLuint texTechno01 = makeTexture("images/techno01.bmp");
     if(texTechno01==0){ texTechno01 = makeTexture("images/techno.bmp"); }
-    if(texTechno01!=0 && state.robot.handGeom){ state.robot.handGeom->texture = texTechno01; state.robot.handGeom->useTexture = true; if(state.robot.handGeom->shape){ auto &cols = state.robot.handGeom->shape->colors; for(auto &c: cols) c = glm::vec4(1.0f); glBindBuffer(GL_ARRAY_BUFFER, state.robot.handGeom->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data()); glBindBuffer(GL_ARRAY_BUFFER, 0); } }
-    if(state.texPlatform!=0){ if(state.robot.gripperLeft){ state.robot.gripperLeft->texture = state.texPlatform; state.robot.gripperLeft->useTexture = true; if(state.robot.gripperLeft->shape){ auto &cols = state.robot.gripperLeft->shape->colors; for(auto &c: cols) c = glm::vec4(1.0f); glBindBuffer(GL_ARRAY_BUFFER, state.robot.gripperLeft->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data()); glBindBuffer(GL_ARRAY_BUFFER, 0); } } if(state.robot.gripperRight){ state.robot.gripperRight->texture = state.texPlatform; state.robot.gripperRight->useTexture = true; if(state.robot.gripperRight->shape){ auto &cols = state.robot.gripperRight->shape->colors; for(auto &c: cols) c = glm::vec4(1.0f); glBindBuffer(GL_ARRAY_BUFFER, state.robot.gripperRight->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, cols.size()*sizeof(glm::vec4), cols.data()); glBindBuffer(GL_ARRAY_BUFFER, 0); } } }
+    if(texTechno01!=0 && state.robot.handGeom){ state.robot.handGeom->texture = texTechno01; state.robot.handGeom->useTexture = true; state.robot.handGeom->color = glm::vec4(1.0f); }
+    if(state.texPlatform!=0){ if(state.robot.gripperLeft){ state.robot.gripperLeft->texture = state.texPlatform; state.robot.gripperLeft->useTexture = true; state.robot.gripperLeft->color = glm::vec4(1.0f); } if(state.robot.gripperRight){ state.robot.gripperRight->texture = state.texPlatform; state.robot.gripperRight->useTexture = true; state.robot.gripperRight->color = glm::vec4(1.0f); } }
     std::cout << "Robot positioned on platform.\n";
 
     //Loading human and car models
@@ -616,12 +631,17 @@ int main(){
         bool okC = state.carModel.load("car.mod");
         if(!okH) std::cerr << "Warning: could not load human.mod\n";
         if(!okC) std::cerr << "Warning: could not load car.mod\n";
+        // props are only ever moved as a whole (humanWorld/carWorld)
+        state.humanModel.root->set_bake(true);
+        state.carModel.root->set_bake(true);
         const float s = 0.5f;
         state.humanWorld = glm::translate(glm::mat4(1.0f), glm::vec3(-1.6f, 0.0f, 1.2f)) * glm::rotate(glm::mat4(1.0f), glm::radians(20.0f), glm::vec3(0,1,0)) * glm::scale(glm::mat4(1.0f), glm::vec3(s));
         if(okH){ glm::vec3 mn, mx; if(compute_aabb(state.humanModel, state.humanWorld, mn, mx)){ if(mn.y != 0.0f){ state.humanWorld = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -mn.y, 0.0f)) * state.humanWorld; } } }
         state.carWorld   = glm::translate(glm::mat4(1.0f), glm::vec3(1.8f, 0.0f, 0.0f)) * glm::rotate(glm::mat4(1.0f), glm::radians(0.0f), glm::vec3(0,1,0)) * glm::scale(glm::mat4(1.0f), glm::vec3(s));
         if(okC){ glm::vec3 mn, mx; if(compute_aabb(state.carModel, state.carWorld, mn, mx)){ if(mn.y != 0.0f){ state.carWorld = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -mn.y, 0.0f)) * state.carWorld; } } }
     }
+    geometry_cache_t::instance().print_stats();
+    shader_cache_t::instance().print_stats();
 
     float aspect = 1024.0f/768.0f;
     glm::mat4 projScene = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 200.0f);
@@ -708,47 +728,34 @@ int main(){
             
             glm::mat4 VP = proj * view;
 
-            glUniform1i(glGetUniformLocation(prog,"numLights"), 2);
-            glUniform3fv(glGetUniformLocation(prog,"lightPos[0]"), 1, &lights.l0Pos[0]);
-            glUniform3fv(glGetUniformLocation(prog,"lightColor[0]"), 1, &lights.l0Col[0]);
-            glUniform1i(glGetUniformLocation(prog,"lightOn[0]"), lights.l0On?1:0);
-            glUniform3fv(glGetUniformLocation(prog,"lightPos[1]"), 1, &lights.l1Pos[0]);
-            glUniform3fv(glGetUniformLocation(prog,"lightColor[1]"), 1, &lights.l1Col[0]);
-            glUniform1i(glGetUniformLocation(prog,"lightOn[1]"), lights.l1On?1:0);
+            // frame constants: one uniform buffer upload, plus the light
+            // lists of this camera's clusters
+            frame_block_t fb;
+            fb.viewProj = VP;
             glm::mat4 handWorld;
             state.robot.model.get_world_frame_of(state.robot.hand, handWorld);
-            glm::vec3 toyPos = glm::vec3(handWorld * glm::vec4(0, state.robot.handHeight, 0, 1));
-            glUniform3fv(glGetUniformLocation(prog,"toyLightPos"), 1, &toyPos[0]);
-            glUniform3fv(glGetUniformLocation(prog,"toyLightColor"), 1, &lights.toyCol[0]);
-            glUniform1i(glGetUniformLocation(prog,"toyLightOn"), lights.toyOn?1:0);
-
-            // draw room
-            state.scene.draw(mvpLoc, modelLoc, VP, state.useTexLoc);
-
-            // Draw additional models
-            if(state.humanModel.root) state.humanModel.draw_recursive(state.humanModel.root.get(), VP, state.humanWorld, mvpLoc, modelLoc, state.useTexLoc);
-            if(state.carModel.root) state.carModel.draw_recursive(state.carModel.root.get(), VP, state.carWorld, mvpLoc, modelLoc, state.useTexLoc);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, 0);
-
-            // Draw robot
-            state.robot.draw(mvpLoc, modelLoc, VP, state.useTexLoc);
-
-            // Draw Camera Visualizers
+            lights.lights[LIGHT_TOY].position = glm::vec3(handWorld * glm::vec4(0, state.robot.handHeight, 0, 1));
+            uint32_t lightKey = lights.build(view, proj, fb);
+            state.frame.upload(fb);
+
+            // room, additional models, robot and camera visualizers go
+            // through one queue so state sorting spans all of them
+            state.queue.clear();
+            state.scene.enqueue(state.queue, VP);
+            state.humanModel.enqueue(state.queue, VP, state.humanWorld);
+            state.carModel.enqueue(state.queue, VP, state.carWorld);
+            state.robot.enqueue(state.queue, VP);
             if (state.camMode == CAM_SCENE && !g_isPlaying) {
-                glm::mat4 identity = glm::mat4(1.0f);
-                if (g_cameraPathSpline) {
-                    state.scene.draw_recursive(g_cameraPathSpline.get(), VP, identity, mvpLoc, modelLoc, state.useTexLoc);
-                }
-                if (g_cameraControlPolygon) {
-                    state.scene.draw_recursive(g_cameraControlPolygon.get(), VP, identity, mvpLoc, modelLoc, state.useTexLoc);
-                }
-                if (g_cameraControlPoints) {
-                    state.scene.draw_recursive(g_cameraControlPoints.get(), VP, identity, mvpLoc, modelLoc, state.useTexLoc);
-                }
+                g_cameraPathVisuals.enqueue(state.queue, VP);
             }
+            state.queue.submit(lightKey);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, 0);
             
             glfwSwapBuffers(win);
+            if(render_stats_t::instance().frames == 0)
+                std::cout << "First frame after " << glfwGetTime() * 1000.0 << " ms\n"; // since glfwInit
+            render_stats_t::instance().end_frame();
         } 
 
         glfwPollEvents();
@@ -2,27 +2,36 @@
 // model.cpp : Hierarchical model utilities (save/load/draw/world-frame query)
 // -----------------------------------------------------------------------------
 #include "model.hpp"
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
 #include "sphere.hpp"
 #include "box.hpp"
 #include "cylinder.hpp"
 #include "cone.hpp"
+#include "geometry_cache.hpp"
+#include "render_stats.hpp"
+#include "simd_math.hpp"
+#include "baked_mesh.hpp"
+#include "model_binary.hpp"
+#include "text_writer.hpp"
 #include <GL/glew.h>
 #include <functional>
+#include <map>
+#include <tuple>
 
 model_t::model_t(){ root = std::make_unique<HNode>(); }
 model_t::~model_t(){ clear(); }
 void model_t::clear(){ root = std::make_unique<HNode>(); }
 
-HNode* model_t::add_shape(std::unique_ptr<shape_t> s){
-    auto node = std::make_unique<HNode>(std::move(s));
-    HNode* ptr = node.get();
-    root->children.push_back(std::move(node));
-    return ptr;
+HNode* model_t::add_shape(std::shared_ptr<shape_t> s){
+    return root->add_child(std::make_unique<HNode>(std::move(s)));
 }
-void model_t::remove_last(){ if(!root->children.empty()) root->children.pop_back(); }
+void model_t::remove_last(){ if(!root->children.empty()){ root->children.pop_back(); root->topology_dirty = true; } }
 
 glm::vec3 model_t::compute_centroid() const {
     std::vector<glm::vec3> pts;
@@ -40,184 +49,432 @@ glm::vec3 model_t::compute_centroid() const {
     return s / float(pts.size());
 }
 
+static bool is_binary(const std::string &fname){
+    return fname.size() > 5 && fname.compare(fname.size() - 5, 5, ".modb") == 0;
+}
+
 // Serialize hierarchy with indentation per depth. Stores shape type/level,
-// color, translate/scale, and full 4x4 rotation matrix.
-bool model_t::save(const std::string &fname) const {
+// color, translate/scale, full 4x4 rotation matrix and quaternion. Floats are written
+// in their shortest round-trip form (text_writer_t), so load() gets the exact
+// bits back.
+bool model_t::save(const std::string &fname, bool embedMeshes) const {
     std::string filepath = "models/" + fname;
     std::cout << "Attempting to save to: " << filepath << std::endl;
-    std::ofstream of(filepath);
-    if(!of) {
-        std::cout << "Failed to open file for writing: " << filepath << std::endl;
-        return false;
-    }
+    if(is_binary(fname)) return save_modb(root.get(), filepath, embedMeshes);
 
-    std::function<void(const HNode*, int)> ser = [&](const HNode* n, int depth){
-        if(!n) return;
+    text_writer_t of;
+    std::vector<std::pair<const HNode*, int>> stack{ {root.get(), 0} }; // depth-first, explicit stack
+    while(!stack.empty()){
+        const HNode* n = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
 
         // indentation for hierarchy
-        for(int i=0;i<depth;i++) of << "  ";
+        of.pad(2 * size_t(depth));
 
         // shape type and tessellation
-        if(n->shape) of << n->shape->name() << " " << int(n->shape->level) << " ";
+        if(n->shape) of << n->shape->name() << ' ' << int(n->shape->level) << ' ';
         else of << "none 0 ";
 
-        // color - use the actual color from the node, or from shape's first vertex if available
-        glm::vec4 colorToSave = n->color;
-        if(n->shape && !n->shape->colors.empty()) {
-            // Use the shape's actual color (they're all the same per shape)
-            colorToSave = n->shape->colors[0];
-        }
-        of << colorToSave.r << "," << colorToSave.g << "," << colorToSave.b << "," << colorToSave.a << " ";
+        // color (per-node material)
+        const glm::vec4 &colorToSave = n->color;
+        of << colorToSave.r << ',' << colorToSave.g << ',' << colorToSave.b << ',' << colorToSave.a << ' ';
 
         // translation (vec3)
-        glm::vec3 t = glm::vec3(n->translate[3]);
-        of << t.x << "," << t.y << "," << t.z << " ";
+        const glm::vec3 &t = n->translation;
+        of << t.x << ',' << t.y << ',' << t.z << ' ';
 
         // scale (vec3)
-        glm::vec3 s = glm::vec3(n->scale[0][0], n->scale[1][1], n->scale[2][2]);
-        of << s.x << "," << s.y << "," << s.z << " ";
-
-        // rotation (4x4 matrix flattened row-major)
+        const glm::vec3 &s = n->scale;
+        of << s.x << ',' << s.y << ',' << s.z << ' ';
+
+        // rotation (4x4 matrix flattened row-major; file format predates quaternions),
+        // then the quaternion itself: the matrix does not convert back to the
+        // same bits, the quaternion does (readers that stop after 16 values
+        // use the matrix)
+        glm::mat4 R = glm::mat4_cast(n->rotation);
         for(int i=0;i<4;i++) {
             for(int j=0;j<4;j++) {
-                of << n->rotate[i][j];
-                if(!(i==3 && j==3)) of << ",";
+                of << R[i][j];
+                if(!(i==3 && j==3)) of << ',';
             }
         }
-        of << "\n";
+        const glm::quat &r = n->rotation;
+        of << ' ' << r.x << ',' << r.y << ',' << r.z << ',' << r.w << '\n';
 
-        // recurse children
-        for(auto &c: n->children) ser(c.get(), depth+1);
-    };
+        // children next, in order
+        for(auto it = n->children.rbegin(); it != n->children.rend(); ++it) stack.push_back({ it->get(), depth + 1 });
+    }
+    if(!of.write(filepath)) {
+        std::cout << "Failed to open file for writing: " << filepath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Text .mod tokens. A line is walked with a cursor p up to its end; tokens are
+// views into the file buffer (nothing is allocated per node).
+static bool is_blank(char c){ return c == ' ' || c == '\t' || c == '\r'; }
+
+static std::string_view next_token(const char *&p, const char *end){
+    while(p < end && is_blank(*p)) p++;
+    const char* b = p;
+    while(p < end && !is_blank(*p)) p++;
+    return std::string_view(b, size_t(p - b));
+}
 
-    ser(root.get(), 0);
+// One float at p (false if there is none). Values too small for a float
+// (from_chars reports them out of range) round like strtof.
+static bool parse_float(const char *&p, const char *end, float &out){
+    auto r = std::from_chars(p, end, out);
+    if(r.ec == std::errc::invalid_argument) return false;
+    if(r.ec == std::errc::result_out_of_range) out = std::strtof(std::string(p, r.ptr).c_str(), nullptr);
+    p = r.ptr;
     return true;
 }
 
+// "a,b,c" into out[0..n) with sscanf("%f,%f,%f") rules: parsing stops at the
+// first malformed value and the remaining entries keep their defaults
+static void parse_list(std::string_view tok, float *out, int n){
+    const char *p = tok.data(), *end = p + tok.size();
+    for(int i=0;i<n;i++){
+        if(!parse_float(p, end, out[i])) return;
+        if(i + 1 < n && (p == end || *p++ != ',')) return;
+    }
+}
+
 // Parse text format generated by save() and reconstruct the hierarchy.
+// The whole file is read into one buffer and tokenized in a single pass.
 bool model_t::load(const std::string &fname) {
     std::string filepath = "models/" + fname;
     std::cout << "Attempting to load from: " << filepath << std::endl;
-    std::ifstream inf(filepath);
-    if(!inf) {
+    if(is_binary(fname)){
+        // built aside, so a missing or corrupt file keeps the current model
+        auto loaded = std::make_unique<HNode>();
+        if(!load_modb(filepath, loaded.get())) return false;
+        root = std::move(loaded);
+        return true;
+    }
+    FILE* f = fopen(filepath.c_str(), "rb");
+    if(!f) {
         std::cout << "Failed to open file for reading: " << filepath << std::endl;
         return false;
     }
+    std::string buf;
+    fseek(f, 0, SEEK_END);
+    buf.resize(size_t(ftell(f)));
+    rewind(f);
+    size_t got = fread(&buf[0], 1, buf.size(), f);
+    fclose(f);
+    buf.resize(got);
 
     clear();
-    std::string line;
+    // meshes are made after parsing, for all (ShapeType, level) pairs at once
+    std::vector<geometry_key_t> keys;
+    int slot[4][5];                              // index into keys, -1: unused
+    std::fill(&slot[0][0], &slot[0][0] + 20, -1);
+    std::vector<std::pair<HNode*, int>> shaped;  // node, its key
     std::vector<HNode*> stack;
     stack.push_back(root.get());
 
-    while(std::getline(inf, line)) {
-        if(line.find_first_not_of(" \t\r\n") == std::string::npos) continue;
+    const char *p = buf.data(), *end = p + buf.size();
+    while(p < end) {
+        const char* eol = (const char*)memchr(p, '\n', size_t(end - p));
+        if(!eol) eol = end;
+        const char* line = p;
+        p = eol + 1;
+        const char* q = line;
+        while(q < eol && is_blank(*q)) q++;
+        if(q == eol) continue;
 
         // count indentation (2 spaces per depth)
         int depth = 0;
-        while(depth < (int)line.size() && (line[depth] == ' ' || line[depth] == '\t'))
+        while(line + depth < eol && (line[depth] == ' ' || line[depth] == '\t'))
             depth += 2;
-
-        std::istringstream ss(line.substr(depth));
-        std::string type; int lev;
-        std::string colorstr, trans, sc, rots;
-
-        // ss >> type >> lev >> colorstr >> trans >> sc >> rots;
-        ss >> type >> lev >> colorstr >> trans >> sc;
-        std::getline(ss, rots);
-        rots.erase(0, rots.find_first_not_of(" \t"));
-
-        // create shape
-        std::unique_ptr<shape_t> s;
-        if(type=="sphere")   s = std::make_unique<sphere_t>(lev);
-        else if(type=="box") s = std::make_unique<box_t>(lev);
-        else if(type=="cylinder") s = std::make_unique<cylinder_t>(lev);
-        else if(type=="cone")     s = std::make_unique<cone_t>(lev);
-
-        auto node = std::make_unique<HNode>(std::move(s));
-
-        // parse color
-        float r=1,g=1,b=1,a=1;
-        sscanf(colorstr.c_str(), "%f,%f,%f,%f", &r,&g,&b,&a);
-        node->color = glm::vec4(r,g,b,a);
-
-        if(node->shape){
-            auto &cols = node->shape->colors;
-            for(auto &c : cols){
-                c = node->color;
-            }
-            glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]);
-            glBufferSubData(GL_ARRAY_BUFFER, 0,
-                            cols.size() * sizeof(glm::vec4), cols.data());
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        q = std::min(line + depth, eol);
+
+        // type level color translate scale rotation; after a bad level the
+        // rest of the line is ignored
+        std::string_view type = next_token(q, eol);
+        std::string_view colorstr, trans, sc;
+        int lev = 0;
+        while(q < eol && is_blank(*q)) q++;
+        auto r = std::from_chars(q, eol, lev);
+        bool fields = r.ec == std::errc();
+        if(fields){
+            q = r.ptr;
+            colorstr = next_token(q, eol);
+            trans = next_token(q, eol);
+            sc = next_token(q, eol);
+        } else lev = 0;
+
+        // shared shape; color is node material state
+        auto node = std::make_unique<HNode>();
+        geometry_key_t key;
+        if(geometry_cache_t::name_key(type, unsigned(lev), key)){
+            int &k = slot[key.type][key.level];
+            if(k < 0){ k = int(keys.size()); keys.push_back(key); }
+            shaped.push_back({ node.get(), k });
         }
-
-
-        // parse translate and scale
-        float tx=0,ty=0,tz=0;
-        float sx=1,sy=1,sz=1;
-        sscanf(trans.c_str(), "%f,%f,%f", &tx,&ty,&tz);
-        sscanf(sc.c_str(), "%f,%f,%f", &sx,&sy,&sz);
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(tx,ty,tz));
-        node->scale     = glm::scale(glm::mat4(1.0f), glm::vec3(sx,sy,sz));
-
-    // parse rotation (16 floats from comma-separated string)
-        glm::mat4 R(1.0f);
-        {
-            std::replace(rots.begin(), rots.end(), ',', ' ');
-            std::istringstream rs(rots);
-            for(int i=0;i<4;i++)
-                for(int j=0;j<4;j++)
-                    rs >> R[i][j];
+        float c[4] = {1,1,1,1}, t[3] = {0,0,0}, s[3] = {1,1,1};
+        parse_list(colorstr, c, 4);
+        parse_list(trans, t, 3);
+        parse_list(sc, s, 3);
+        node->color = glm::vec4(c[0], c[1], c[2], c[3]);
+        node->translation = glm::vec3(t[0], t[1], t[2]);
+        node->scale       = glm::vec3(s[0], s[1], s[2]);
+
+        // rotation: 16 floats separated by commas and/or blanks, then
+        // optionally the exact quaternion x,y,z,w (files from older saves
+        // end after the matrix)
+        float v[20];
+        int got = 0;
+        while(fields && got < 20){
+            while(q < eol && (*q == ',' || is_blank(*q))) q++;
+            if(!parse_float(q, eol, v[got])) break;
+            got++;
+        }
+        if(got == 20) node->rotation = glm::quat(v[19], v[16], v[17], v[18]);
+        else {
+            glm::mat4 R(1.0f);
+            for(int i=0;i<got && i<16;i++) R[i/4][i%4] = v[i];
+            node->rotation = glm::normalize(glm::quat_cast(glm::mat3(R))); // rotation part only
         }
-        node->rotate = R;
 
-        // attach to tree
-        if(depth/2+1 > (int)stack.size()) stack.push_back(node.get());
+        // attach to tree (a line indented past its parent's child level
+        // attaches to the previous node)
         while((int)stack.size() > depth/2 + 1) stack.pop_back();
-
-        stack.back()->children.push_back(std::move(node));
-        stack.push_back(stack.back()->children.back().get());
+        HNode* parent = stack.back();
+        node->parent = parent;
+        parent->children.push_back(std::move(node));
+        stack.push_back(parent->children.back().get());
+    }
+    // acquire_all counted each key once; every later node on a key is a hit
+    geometry_cache_t &cache = geometry_cache_t::instance();
+    std::vector<std::shared_ptr<shape_t>> meshes = cache.acquire_all(keys);
+    std::vector<char> handed(keys.size(), 0);
+    for(auto &n : shaped){
+        n.first->shape = meshes[n.second];
+        if(handed[n.second]) cache.count_hit(*n.first->shape);
+        handed[n.second] = 1;
     }
+    root->topology_dirty = true;
 
     return true;
 }
 
-// Depth-first draw traversal. worldFrame excludes scale to keep normals well-defined;
-// M (Model) applies scale to geometry. MVP uses full M so that parent scales affect children.
-void model_t::draw_recursive(HNode* node, const glm::mat4 &parentVP, const glm::mat4 &parentWorld, GLuint mvpLoc, GLuint modelLoc, GLint useTexLoc) const {
-    if(!node) return;
-    glm::mat4 worldFrame = parentWorld * node->translate * node->rotate; // no scale for frame
-    glm::mat4 M = worldFrame * node->scale; // apply scale to geometry
-    // Fix: MVP must be computed with the full Model matrix so parent transforms apply
-    glm::mat4 MVP = parentVP * M;
+// Flatten the tree depth-first (explicit stack: hierarchies may be deep).
+// Every node is marked dirty so the next pass fills all world matrices.
+void model_t::compile() const {
+    flat = flat_nodes_t();
+    if(!root) return;
+    std::vector<std::pair<HNode*, int>> stack{ {root.get(), -1} };
+    while(!stack.empty()){
+        HNode* n = stack.back().first;
+        int p = stack.back().second;
+        stack.pop_back();
+        int i = int(flat.node.size());
+        n->flat_index = i;
+        n->dirty = true;
+        flat.node.push_back(n);
+        flat.parent.push_back(p);
+        for(auto it = n->children.rbegin(); it != n->children.rend(); ++it) stack.push_back({it->get(), i});
+    }
+    // parents precede children, so one backward sweep closes every subtree range
+    flat.subtree_end.resize(flat.size());
+    for(size_t i = 0; i < flat.size(); i++) flat.subtree_end[i] = int(i) + 1;
+    for(size_t i = flat.size(); i-- > 1;){
+        int p = flat.parent[i];
+        flat.subtree_end[p] = std::max(flat.subtree_end[p], flat.subtree_end[i]);
+    }
+    flat.local.resize(flat.size());
+    flat.world.resize(flat.size());
+    flat.model.resize(flat.size());
+    flat.box.resize(flat.size());
+    flat.own.resize(flat.size());
+    flat.bounds.resize(flat.size());
+    flat.mark.assign(flat.size(), 0);
+    flat.changed.assign(flat.size(), 0);
+    // outermost bake roots only; meshes are built on first enqueue
+    for(size_t i = 0; i < flat.size(); i++){
+        if(!flat.node[i]->bake) continue;
+        bake_t b;
+        b.root = int(i);
+        flat.bakes.push_back(std::move(b));
+        i = flat.subtree_end[i] - 1;
+    }
+    root->topology_dirty = false;
+}
 
-    glUniformMatrix4fv(mvpLoc,1,GL_FALSE,&MVP[0][0]);
-    glUniformMatrix4fv(modelLoc,1,GL_FALSE,&M[0][0]);
+// One linear pass: a node is recomputed if its own TRS changed or its parent
+// was recomputed this pass (parents always precede children in the arrays).
+// The products and the world boxes then run as batched kernels over the
+// arrays. world excludes scale to keep normals well-defined; model applies it.
+// Bounds are redone only for recomputed nodes, nodes given a new shape and
+// their ancestors.
+void model_t::update_world(const glm::mat4 &parentWorld) const {
+    if(!root) return;
+    if(root->topology_dirty) compile();
+    bool rootMoved = rootWorld != parentWorld;
+    rootWorld = parentWorld;
+    const mat_kernels_t &K = mat_kernels_t::active();
+    flat.work.clear();
+    flat.rebound.clear();
+    for(size_t i = 0; i < flat.size(); i++){
+        HNode* n = flat.node[i];
+        int p = flat.parent[i];
+        bool ch = n->dirty || (p < 0 ? rootMoved : flat.changed[p] != 0);
+        flat.changed[i] = ch;
+        if(ch || n->bounds_dirty){
+            flat.rebound.push_back(int(i));
+            n->bounds_dirty = false;
+        }
+        if(!ch) continue;
+        flat.local[i] = n->local_frame();
+        n->dirty = false;
+        flat.work.push_back(int(i));
+    }
+    size_t updates = flat.work.size();
+    render_stats_t::instance().cur.world_updates += updates;
+    if(updates > 0){
+        K.propagate(parentWorld, flat.parent.data(), flat.local.data(), flat.world.data(), flat.work.data(), updates);
+        for(int i : flat.work) flat.model[i] = glm::scale(flat.world[i], flat.node[i]->scale);
+    }
+    if(flat.rebound.empty()) return;
 
-    // set texturing flag
-    if(useTexLoc >= 0){ glUniform1i(useTexLoc, node->useTexture ? 1 : 0); }
-    if(node->useTexture && node->texture!=0){
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, node->texture);
+    // own boxes, then subtree boxes of those nodes and their ancestors,
+    // children first (higher indices)
+    for(int i : flat.rebound){
+        const auto &shape = flat.node[i]->shape;
+        flat.box[i] = shape ? shape->local_bounds() : aabb_t();
+    }
+    K.bounds(flat.model.data(), flat.box.data(), flat.own.data(), flat.rebound.data(), flat.rebound.size());
+    flat.regrow = flat.rebound;
+    for(int i : flat.rebound) flat.mark[i] = 1;
+    for(int i : flat.rebound){
+        for(int p = flat.parent[i]; p >= 0 && !flat.mark[p]; p = flat.parent[p]){
+            flat.mark[p] = 1;
+            flat.regrow.push_back(p);
+        }
     }
+    auto regrow = [&](int i){
+        flat.bounds[i] = flat.own[i];
+        for(int c = i + 1; c < flat.subtree_end[i]; c = flat.subtree_end[c]) flat.bounds[i].grow(flat.bounds[c]);
+        flat.mark[i] = 0;
+    };
+    if(flat.regrow.size() * 8 > flat.size()){
+        for(size_t i = flat.size(); i-- > 0;) if(flat.mark[i]) regrow(int(i));
+    } else {
+        std::sort(flat.regrow.begin(), flat.regrow.end(), std::greater<int>());
+        for(int i : flat.regrow) regrow(i);
+    }
+}
 
-    if(node->shape){ node->shape->draw(); }
-    for(auto &c: node->children) draw_recursive(c.get(), parentVP, worldFrame, mvpLoc, modelLoc, useTexLoc);
+aabb_t model_t::world_bounds(const glm::mat4 &world) const {
+    if(!root) return aabb_t();
+    update_world(world);
+    return flat.bounds[0];
+}
+
+// Merge every indexed shape of the subtree into one mesh per material, in
+// the root's frame (world[root] without scale).
+void model_t::rebake(bake_t &b) const {
+    b.meshes.clear();
+    b.loose.clear();
+    b.nodes = 0;
+    const glm::mat4 toRoot = glm::inverse(flat.world[b.root]);
+    std::map<std::tuple<GLuint, bool, bool, float, float, float, float>, size_t> slot;
+    for(int j = b.root; j < flat.subtree_end[b.root]; j++){
+        const HNode* n = flat.node[j];
+        if(!n->shape) continue;
+        if(!n->shape->in_arena()){ b.loose.push_back(j); continue; }
+        auto key = std::make_tuple(n->useTexture ? n->texture : 0u, n->useTexture, n->perPixel, n->color.r, n->color.g, n->color.b, n->color.a);
+        auto it = slot.find(key);
+        if(it == slot.end()){
+            it = slot.emplace(key, b.meshes.size()).first;
+            b.meshes.push_back({ n, std::make_shared<baked_mesh_t>() });
+        }
+        static_cast<baked_mesh_t&>(*b.meshes[it->second].second).append(*n->shape, toRoot * flat.model[j]);
+        b.nodes++;
+    }
+    for(auto &m : b.meshes) static_cast<baked_mesh_t&>(*m.second).finish();
+    flat.node[b.root]->bake_edited = false;
+    b.built = true;
+    render_stats_t::instance().cur.rebakes++;
 }
 
-void model_t::draw(GLuint mvpLoc, GLuint modelLoc, const glm::mat4 &viewProj, GLint useTexLoc) const {
+void model_t::enqueue(render_queue_t &q, const glm::mat4 &viewProj, const glm::mat4 &world) const {
     if(!root) return;
-    draw_recursive(root.get(), viewProj, glm::mat4(1.0f), mvpLoc, modelLoc, useTexLoc);
+    update_world(world);
+    const frustum_t frustum(viewProj);
+    const glm::vec4 depthRow(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+    auto &stats = render_stats_t::instance().cur;
+    stats.nodes += flat.size();
+    size_t nextBake = 0;
+    for(size_t i = 0; i < flat.size(); i++){
+        if(!frustum.intersects(flat.bounds[i])){
+            // whole subtree outside (or nothing drawable in it)
+            stats.culled += flat.subtree_end[i] - i;
+            while(nextBake < flat.bakes.size() && flat.bakes[nextBake].root < flat.subtree_end[i]) nextBake++;
+            i = flat.subtree_end[i] - 1;
+            continue;
+        }
+        if(nextBake < flat.bakes.size() && flat.bakes[nextBake].root == int(i)){
+            // static subtree: its merged meshes, placed by the root frame
+            bake_t &b = flat.bakes[nextBake++];
+            if(!b.built || flat.node[b.root]->bake_edited) rebake(b);
+            float depth = glm::dot(depthRow, flat.world[i][3]);
+            for(auto &m : b.meshes) q.push(m.second.get(), m.first, flat.world[i], depth);
+            for(int j : b.loose) q.push(flat.node[j]->shape.get(), flat.node[j], flat.model[j], glm::dot(depthRow, flat.model[j][3]));
+            stats.visible += b.nodes + b.loose.size();
+            stats.baked += b.nodes;
+            i = flat.subtree_end[i] - 1;
+            continue;
+        }
+        const HNode* node = flat.node[i];
+        if(!node->shape) continue;
+        // interior node: its subtree is visible, test its own shape as well
+        if(flat.subtree_end[i] > int(i) + 1 && !frustum.intersects(flat.own[i])){
+            stats.culled++;
+            continue;
+        }
+        q.push(node->shape.get(), node, flat.model[i], glm::dot(depthRow, flat.model[i][3]));
+        stats.visible++;
+    }
 }
 
-bool model_t::get_world_frame_of_rec(const HNode* node, const HNode* target, const glm::mat4 &parentWorld, glm::mat4 &outWorld) const{
-    if(!node) return false;
-    glm::mat4 world = parentWorld * node->translate * node->rotate;
-    if(node==target){ outWorld = world; return true; }
-    for(auto &c: node->children){ if(get_world_frame_of_rec(c.get(), target, world, outWorld)) return true; }
-    return false;
+void model_t::draw(uint32_t frameKey, const glm::mat4 &viewProj, const glm::mat4 &world) const {
+    static render_queue_t q;
+    q.clear();
+    enqueue(q, viewProj, world);
+    q.submit(frameKey);
 }
 
+// Walk the ancestor chain only (O(depth)). With a clean chain the flat world
+// matrix is returned directly; otherwise T*R is re-accumulated from the highest
+// dirty ancestor without touching the caches (siblings still rely on the flags).
 bool model_t::get_world_frame_of(const HNode* target, glm::mat4 &outWorld) const{
-    return get_world_frame_of_rec(root.get(), target, glm::mat4(1.0f), outWorld);
+    if(!root || !target) return false;
+    if(root->topology_dirty) compile();
+    int idx = target->flat_index;
+    if(idx < 0 || idx >= int(flat.size()) || flat.node[idx] != target) return false; // not part of this model
+    auto &stats = render_stats_t::instance().cur;
+    stats.world_queries++;
+    const HNode* top = target;     // highest node that needs recomputation
+    bool clean = !target->dirty;
+    for(const HNode* n = target; n->parent; n = n->parent){
+        stats.query_steps++;
+        if(n->parent->dirty){ clean = false; top = n->parent; }
+    }
+    // frames are relative to the model root (draw() places it at identity)
+    if(rootWorld != glm::mat4(1.0f)){ clean = false; top = root.get(); }
+    if(clean){ outWorld = flat.world[idx]; return true; }
+
+    glm::mat4 world = top->parent ? flat.world[top->parent->flat_index] : glm::mat4(1.0f);
+    std::vector<const HNode*> chain;
+    for(const HNode* c = target; c != top; c = c->parent) chain.push_back(c);
+    chain.push_back(top);
+    for(auto it = chain.rbegin(); it != chain.rend(); ++it) world = mat_mul(world, (*it)->local_frame());
+    outWorld = world;
+    return true;
 }
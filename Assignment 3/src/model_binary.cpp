@@ -0,0 +1,187 @@
+// -----------------------------------------------------------------------------
+// model_binary.cpp : .modb writer and memory-mapped loader.
+// -----------------------------------------------------------------------------
+#include "model_binary.hpp"
+#include "model.hpp"
+#include "geometry_cache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// shape_t::name() of each ShapeType
+static const char* shape_names[4] = { "sphere", "cylinder", "box", "cone" };
+
+bool save_modb(const HNode* root, const std::string &filepath, bool embedMeshes){
+    FILE* f = fopen(filepath.c_str(), "wb");
+    if(!f){
+        std::cout << "Failed to open file for writing: " << filepath << std::endl;
+        return false;
+    }
+    // node table in the order load() rebuilds it: depth-first, children in order
+    std::vector<modb_node_t> nodes;
+    std::map<std::pair<int, unsigned int>, std::shared_ptr<shape_t>> used; // (ShapeType, level) -> mesh
+    std::vector<std::pair<const HNode*, int32_t>> stack{ {root, -1} };
+    while(!stack.empty()){
+        const HNode* n = stack.back().first;
+        int32_t parent = stack.back().second;
+        stack.pop_back();
+        modb_node_t r = {};
+        r.parent = parent;
+        geometry_key_t key;
+        if(n->shape && geometry_cache_t::name_key(n->shape->name(), n->shape->level, key)){
+            r.shape = uint8_t(key.type + 1);
+            r.level = uint8_t(key.level);
+            if(embedMeshes && !used.count({key.type, key.level}))
+                used[{key.type, key.level}] = geometry_cache_t::instance().by_name(n->shape->name(), key.level);
+        }
+        memcpy(r.color, &n->color[0], sizeof(r.color));
+        memcpy(r.translation, &n->translation[0], sizeof(r.translation));
+        memcpy(r.scale, &n->scale[0], sizeof(r.scale));
+        r.rotation[0] = n->rotation.x; r.rotation[1] = n->rotation.y;
+        r.rotation[2] = n->rotation.z; r.rotation[3] = n->rotation.w;
+        int32_t self = int32_t(nodes.size());
+        nodes.push_back(r);
+        for(auto it = n->children.rbegin(); it != n->children.rend(); ++it) stack.push_back({ it->get(), self });
+    }
+
+    // meshes: the default-sized primitive by_name() would build for each (type, level)
+    std::vector<modb_mesh_t> meshes;
+    uint64_t blob = 0;
+    for(auto &kv : used){
+        geometry_key_t key;
+        geometry_cache_t::name_key(shape_names[kv.first.first], kv.first.second, key);
+        modb_mesh_t m = {};
+        m.shape = uint8_t(key.type); m.level = uint8_t(key.level);
+        memcpy(m.dims, &key.dims[0], sizeof(m.dims));
+        m.vertex_count = uint32_t(kv.second->vertices.size());
+        m.index_count = uint32_t(kv.second->indices.size());
+        m.offset = blob;
+        blob += mesh_blob_bytes(m.vertex_count, m.index_count);
+        meshes.push_back(m);
+    }
+
+    modb_header_t h = {};
+    memcpy(h.magic, "MODB", 4);
+    h.version = MODB_VERSION;
+    h.node_count = uint32_t(nodes.size());
+    h.mesh_count = uint32_t(meshes.size());
+    h.node_offset = sizeof(h);
+    h.mesh_offset = h.node_offset + nodes.size() * sizeof(modb_node_t);
+    h.blob_offset = h.mesh_offset + meshes.size() * sizeof(modb_mesh_t);
+    h.blob_bytes = blob;
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(nodes.data(), sizeof(modb_node_t), nodes.size(), f);
+    fwrite(meshes.data(), sizeof(modb_mesh_t), meshes.size(), f);
+    for(auto &kv : used){
+        write_mesh_blob(f, *kv.second);
+    }
+    bool ok = ferror(f) == 0;
+    if(fclose(f) != 0) ok = false;
+    return ok;
+}
+
+bool load_modb(const std::string &filepath, HNode* root){
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if(fd < 0){
+        std::cout << "Failed to open file for reading: " << filepath << std::endl;
+        return false;
+    }
+    struct stat st;
+    size_t size = (fstat(fd, &st) == 0) ? size_t(st.st_size) : 0;
+    void* map = size >= sizeof(modb_header_t) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(map == MAP_FAILED){
+        std::cout << "Not a .modb file: " << filepath << std::endl;
+        return false;
+    }
+    const char* base = (const char*)map;
+    const modb_header_t &h = *(const modb_header_t*)base;
+    auto fits = [&](uint64_t offset, uint64_t bytes){ return offset <= size && bytes <= size - offset; };
+    bool valid = memcmp(h.magic, "MODB", 4) == 0 && h.version == MODB_VERSION
+              && h.node_offset % 8 == 0 && h.mesh_offset % 8 == 0 && h.blob_offset % 8 == 0
+              && fits(h.node_offset, uint64_t(h.node_count) * sizeof(modb_node_t))
+              && fits(h.mesh_offset, uint64_t(h.mesh_count) * sizeof(modb_mesh_t))
+              && fits(h.blob_offset, h.blob_bytes);
+    if(!valid){
+        std::cout << "Not a .modb file (or another version): " << filepath << std::endl;
+        munmap(map, size);
+        return false;
+    }
+
+    // whole node table is checked before anything is made, so a corrupt file
+    // leaves the scene untouched. Parents are always earlier in the table.
+    const modb_node_t* table = (const modb_node_t*)(base + h.node_offset);
+    for(uint32_t i = 0; i < h.node_count; i++){
+        const modb_node_t &r = table[i];
+        if(r.parent < -1 || r.parent >= int32_t(i) || r.shape > CONE_SHAPE + 1){
+            std::cout << "Corrupt node table in " << filepath << std::endl;
+            munmap(map, size);
+            return false;
+        }
+    }
+
+    // embedded meshes, for this file's nodes only. An entry must carry the
+    // dims by_name() uses for its (type, level), like every file save_modb writes.
+    geometry_cache_t &cache = geometry_cache_t::instance();
+    const modb_mesh_t* meshes = (const modb_mesh_t*)(base + h.mesh_offset);
+    std::shared_ptr<shape_t> embedded[4][5];
+    for(uint32_t i = 0; i < h.mesh_count; i++){
+        const modb_mesh_t &m = meshes[i];
+        if(m.shape > CONE_SHAPE || m.level > 4 || m.offset % 4 != 0 || m.offset > h.blob_bytes || mesh_blob_bytes(m.vertex_count, m.index_count) > h.blob_bytes - m.offset) continue;
+        geometry_key_t key;
+        geometry_cache_t::name_key(shape_names[m.shape], m.level, key);
+        if(memcmp(&key.dims[0], m.dims, sizeof(m.dims)) != 0) continue;
+        mesh_data_t d;
+        if(!read_mesh_blob(base + h.blob_offset + m.offset, m.vertex_count, m.index_count, d)) continue;
+        embedded[m.shape][m.level] = cache.adopt(key, std::move(d));
+    }
+
+    // nodes: read in place. Meshes for all other (ShapeType, level) pairs used
+    // are made first, in one batch.
+    std::vector<geometry_key_t> keys;
+    int slot[4][5];                              // index into keys, -1: unused
+    std::fill(&slot[0][0], &slot[0][0] + 20, -1);
+    for(uint32_t i = 0; i < h.node_count; i++){
+        const modb_node_t &r = table[i];
+        if(r.shape < 1 || r.shape > CONE_SHAPE + 1) continue;
+        unsigned int lev = std::min(unsigned(r.level), 4u);
+        int &k = slot[r.shape - 1][lev];
+        if(k >= 0 || embedded[r.shape - 1][lev]) continue;
+        k = int(keys.size());
+        keys.emplace_back();
+        geometry_cache_t::name_key(shape_names[r.shape - 1], lev, keys.back());
+    }
+    // each pair was counted once (acquire_all or adopt); later nodes are hits
+    std::vector<std::shared_ptr<shape_t>> shapes = cache.acquire_all(keys);
+    bool handed[4][5] = {};
+    std::vector<HNode*> made(h.node_count);
+    for(uint32_t i = 0; i < h.node_count; i++){
+        const modb_node_t &r = table[i];
+        auto node = std::make_unique<HNode>();
+        if(r.shape){
+            unsigned int t = r.shape - 1, lev = std::min(unsigned(r.level), 4u);
+            node->shape = embedded[t][lev] ? embedded[t][lev] : shapes[slot[t][lev]];
+            if(handed[t][lev]) cache.count_hit(*node->shape);
+            handed[t][lev] = true;
+        }
+        node->color = glm::vec4(r.color[0], r.color[1], r.color[2], r.color[3]);
+        node->translation = glm::vec3(r.translation[0], r.translation[1], r.translation[2]);
+        node->scale = glm::vec3(r.scale[0], r.scale[1], r.scale[2]);
+        node->rotation = glm::quat(r.rotation[3], r.rotation[0], r.rotation[1], r.rotation[2]);
+        HNode* parent = r.parent < 0 ? root : made[r.parent];
+        node->parent = parent;
+        made[i] = node.get();
+        parent->children.push_back(std::move(node));
+    }
+    root->topology_dirty = true;
+    munmap(map, size);
+    return true;
+}
@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------------------
+// render_queue.cpp : Packet sorting and state-tracked submission.
+// -----------------------------------------------------------------------------
+#include "render_queue.hpp"
+#include "model.hpp"
+#include "render_stats.hpp"
+#include "shader_cache.hpp"
+#include "simd_math.hpp"
+#include <algorithm>
+
+void render_queue_t::push(shape_t* mesh, const HNode* material, const glm::mat4 &model, float depth){
+    const uint64_t program = shader_cache_t::material_key(material);
+    uint64_t tex = (uint64_t(material->texture & 0x7FFF) << 1) | (material->useTexture ? 1 : 0);
+    uint64_t d = uint64_t(glm::clamp(depth, 0.0f, 16383.0f) * 64.0f); // 1/64 unit steps, 20 bits
+    uint64_t key = (program << 56) | (tex << 40) | (uint64_t(mesh->id & 0xFFFFF) << DEPTH_BITS) | d;
+    packets.push_back({ key, mesh, material, uint32_t(matrices.size()) });
+    matrices.push_back(model);
+}
+
+// The key holds only the low bits of texture and mesh ids (ids keep growing,
+// e.g. camera path strips are recreated), so runs compare the values themselves
+static bool same_material(const draw_packet_t &a, const draw_packet_t &b){
+    return (a.key >> 56) == (b.key >> 56) && a.material->texture == b.material->texture
+        && a.material->useTexture == b.material->useTexture;
+}
+static bool same_state(const draw_packet_t &a, const draw_packet_t &b){
+    return a.mesh == b.mesh && same_material(a, b);
+}
+
+// GL state the submission loop carries between packets
+struct bound_state_t {
+    int program = -1;   // material permutation (key bits 63..56)
+    GLuint texture = ~0u;
+    const void* vertices = nullptr; // VAO in use: the shared arena or the shape's own
+    size_t changes = 0;
+
+    // Returns which parts of the state p needs to change (and counts them)
+    bool program_changes(const draw_packet_t &p) const { return int(p.key >> 56) != program; }
+    bool tex_changes(const draw_packet_t &p) const { return p.material->useTexture && p.material->texture != 0 && p.material->texture != texture; }
+    void advance(const draw_packet_t &p){
+        if(program_changes(p)){ program = int(p.key >> 56); changes++; }
+        if(tex_changes(p)){ texture = p.material->texture; changes++; }
+        const void* v = p.mesh->in_arena() ? (const void*)p.mesh->arena : (const void*)p.mesh;
+        if(v != vertices){ vertices = v; changes++; } // VAO bind
+    }
+};
+
+void render_queue_t::submit(uint32_t frameKey){
+    auto &stats = render_stats_t::instance().cur;
+    {
+        // what the same packets would cost submitted in traversal order
+        bound_state_t unsorted;
+        for(const auto &p : packets) unsorted.advance(p);
+        stats.state_changes_unsorted += unsorted.changes;
+    }
+    std::sort(packets.begin(), packets.end(), [](const draw_packet_t &a, const draw_packet_t &b){
+        return a.key != b.key ? a.key < b.key : a.matrix < b.matrix;
+    });
+
+    // Runs of packets with identical state (differing only in depth). Arena
+    // runs become one indirect command each; their per-draw records are
+    // uploaded once for the whole queue.
+    runs.clear(); instances.clear(); commands.clear();
+    for(size_t g = 0; g < packets.size();){
+        size_t end = g + 1;
+        while(end < packets.size() && same_state(packets[end], packets[g])) end++;
+        run_t r{ g, end, -1 };
+        const shape_t* mesh = packets[g].mesh;
+        if(mesh->in_arena()){
+            r.command = int(commands.size());
+            commands.push_back({ mesh->range.index_count, GLuint(end - g), mesh->range.first_index,
+                                 mesh->range.base_vertex, GLuint(instances.size()) });
+            for(size_t k = g; k < end; k++){
+                instance_data_t d;
+                d.model = matrices[packets[k].matrix];
+                d.color = packets[k].material->color;
+                normal_matrix(d.model, d.normal);
+                instances.push_back(d);
+            }
+        }
+        runs.push_back(r);
+        g = end;
+    }
+    vertex_arena_t &arena = vertex_arena_t::instance();
+    if(!commands.empty()){
+        GLuint base = arena.upload_instances(instances.data(), instances.size());
+        for(auto &c : commands) c.baseInstance += base;
+        arena.upload_commands(commands.data(), commands.size());
+    }
+
+    shader_cache_t &shaders = shader_cache_t::instance();
+    bound_state_t bound;
+    for(size_t r = 0; r < runs.size();){
+        const draw_packet_t &first = packets[runs[r].begin];
+        if(bound.program_changes(first)){
+            glUseProgram(shaders.program(uint32_t(first.key >> 56) | frameKey));
+            stats.program_binds++;
+        }
+        if(bound.tex_changes(first)){
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, first.material->texture);
+        }
+        bound.advance(first);
+        if(runs[r].command >= 0){
+            // every following arena run with the same material joins the multi-draw
+            size_t last = r + 1;
+            while(last < runs.size() && runs[last].command >= 0 && same_material(packets[runs[last].begin], first)){
+                bound.advance(packets[runs[last].begin]);
+                last++;
+            }
+            stats.draw_calls += arena.multi_draw(size_t(runs[r].command), last - r);
+            stats.indirect_commands += last - r;
+            stats.instanced += runs[last - 1].end - runs[r].begin;
+            r = last;
+            continue;
+        }
+        // own VAO (no per-draw attribute arrays): feed the record as constant attributes
+        for(size_t k = runs[r].begin; k < runs[r].end; k++){
+            const draw_packet_t &p = packets[k];
+            const glm::mat4 &M = matrices[p.matrix];
+            glm::vec4 N[3];
+            normal_matrix(M, N);
+            for(GLuint c = 0; c < 4; c++) glVertexAttrib4fv(4 + c, &M[c][0]);
+            glVertexAttrib4fv(8, &p.material->color[0]);
+            for(GLuint c = 0; c < 3; c++) glVertexAttrib4fv(9 + c, &N[c][0]);
+            p.mesh->draw();
+            stats.draw_calls++;
+        }
+        r++;
+    }
+    if(!commands.empty()) arena.end_submit();
+    stats.state_changes += bound.changes;
+}
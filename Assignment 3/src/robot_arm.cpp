@@ -5,6 +5,7 @@
 #include "sphere.hpp"
 #include "cylinder.hpp"
 #include "box.hpp"
+#include "geometry_cache.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <GL/glew.h>
 #include <iostream>
@@ -17,16 +18,16 @@ void RobotArm::init() {
     model.clear();
 
     // Ensure no global tilt so base looks horizontal
-    model.root->rotate = glm::mat4(1.0f);
+    model.root->rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 
     // Base 
-    auto baseBox = std::make_unique<box_t>(0);
-    base = model.add_shape(std::move(baseBox));
+    auto &cache = geometry_cache_t::instance();
+    base = model.add_shape(nullptr);
     // Base scaling parameters
     const float baseScaleX = 0.5f, baseScaleY = 0.3f, baseScaleZ = 0.5f;
-    base->scale = glm::scale(glm::mat4(1.0f), glm::vec3(baseScaleX, baseScaleY, baseScaleZ));
+    base->scale = glm::vec3(baseScaleX, baseScaleY, baseScaleZ);
     base->color = glm::vec4(0.9f, 0.8f, 0.2f, 1.0f);
-    if(base->shape){ for(auto &c: base->shape->colors) c = base->color; glBindBuffer(GL_ARRAY_BUFFER, base->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, base->shape->colors.size()*sizeof(glm::vec4), base->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);}   
+    base->shape = cache.box(0, glm::vec3(0.5f));
 
     // Dimensions (derive baseTop from base half-height (0.5) and Y scale)
     const float baseRadius = 0.5f; // box_t default half extent
@@ -39,76 +40,71 @@ void RobotArm::init() {
 
     // LOWER ARM JOINT (empty pivot node at top of base)
     auto lowerJoint = std::make_unique<HNode>();
-    lowerJoint->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, baseTop, 0.0f));
+    lowerJoint->translation = glm::vec3(0.0f, baseTop, 0.0f);
     lowerArm = lowerJoint.get();
-    base->children.push_back(std::move(lowerJoint));
+    base->add_child(std::move(lowerJoint));
 
     // Visual base joint sphere at top of base (between base and red cylinder)
     {
-        auto sph = std::make_unique<sphere_t>(2);
-        auto node = std::make_unique<HNode>(std::move(sph));
+        auto node = std::make_unique<HNode>();
         // Place the sphere center exactly at the joint pivot (baseTop)
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 0.0f));
-        node->scale = glm::scale(glm::mat4(1.0f), glm::vec3(jointR));
+        node->translation = glm::vec3(0.0f, 0.0f, 0.0f);
+        node->scale = glm::vec3(jointR);
         node->color = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
-        lowerArm->children.push_back(std::move(node));
+        node->shape = cache.sphere(2, 0.5f);
+        lowerArm->add_child(std::move(node));
     }
 
     // Lower arm geometry (cylinder) under lowerArm joint; pivot at its bottom
     {
-        auto cyl = std::make_unique<cylinder_t>(2);
-        auto node = std::make_unique<HNode>(std::move(cyl));
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, lowerLen*0.5f, 0.0f));
-        node->scale     = glm::scale(glm::mat4(1.0f), glm::vec3(0.12f, lowerLen, 0.12f));
+        auto node = std::make_unique<HNode>();
+        node->translation = glm::vec3(0.0f, lowerLen*0.5f, 0.0f);
+        node->scale     = glm::vec3(0.12f, lowerLen, 0.12f);
         node->color     = glm::vec4(1.0f, 0.3f, 0.3f, 1.0f); // brighter red
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
+        node->shape     = cache.cylinder(2, 0.4f, 1.0f);
         lowerArmGeom = node.get();
-        lowerArm->children.push_back(std::move(node));
+        lowerArm->add_child(std::move(node));
     }
 
     // UPPER ARM JOINT (empty) placed exactly at top of lower arm
     auto upperJoint = std::make_unique<HNode>();
-    upperJoint->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, lowerLen, 0.0f));
+    upperJoint->translation = glm::vec3(0.0f, lowerLen, 0.0f);
     upperArm = upperJoint.get();
-    lowerArm->children.push_back(std::move(upperJoint));
+    lowerArm->add_child(std::move(upperJoint));
 
     // Visual middle joint sphere at the upper joint
     {
-        auto sph = std::make_unique<sphere_t>(2);
-        auto node = std::make_unique<HNode>(std::move(sph));
-        node->scale = glm::scale(glm::mat4(1.0f), glm::vec3(jointR));
+        auto node = std::make_unique<HNode>();
+        node->scale = glm::vec3(jointR);
         node->color = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
-        upperArm->children.push_back(std::move(node));
+        node->shape = cache.sphere(2, 0.5f);
+        upperArm->add_child(std::move(node));
     }
 
     // Upper arm geometry under upperArm joint; pivot at its bottom
     {
-        auto cyl = std::make_unique<cylinder_t>(2);
-        auto node = std::make_unique<HNode>(std::move(cyl));
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, upperLen*0.5f, 0.0f));
-        node->scale     = glm::scale(glm::mat4(1.0f), glm::vec3(0.10f, upperLen, 0.10f));
+        auto node = std::make_unique<HNode>();
+        node->translation = glm::vec3(0.0f, upperLen*0.5f, 0.0f);
+        node->scale     = glm::vec3(0.10f, upperLen, 0.10f);
         node->color     = glm::vec4(0.3f, 0.6f, 1.0f, 1.0f); // brighter blue
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
+        node->shape     = cache.cylinder(2, 0.4f, 1.0f);
         upperArmGeom = node.get();
-        upperArm->children.push_back(std::move(node));
+        upperArm->add_child(std::move(node));
     }
 
     // WRIST JOINT (empty) placed exactly at top of upper arm
     auto wristJ = std::make_unique<HNode>();
-    wristJ->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, upperLen, 0.0f));
+    wristJ->translation = glm::vec3(0.0f, upperLen, 0.0f);
     wristJoint = wristJ.get();
-    upperArm->children.push_back(std::move(wristJ));
+    upperArm->add_child(std::move(wristJ));
 
     // Visual wrist sphere
     {
-        auto sph = std::make_unique<sphere_t>(2);
-        auto node = std::make_unique<HNode>(std::move(sph));
-        node->scale = glm::scale(glm::mat4(1.0f), glm::vec3(jointR*0.9f));
+        auto node = std::make_unique<HNode>();
+        node->scale = glm::vec3(jointR*0.9f);
         node->color = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
-        wristJoint->children.push_back(std::move(node));
+        node->shape = cache.sphere(2, 0.5f);
+        wristJoint->add_child(std::move(node));
     }
 
     // Use wrist joint as the hand joint for rotations
@@ -120,15 +116,14 @@ void RobotArm::init() {
         // Wider hand box
         handWidth = 0.35f;           
         const float handDepth = 0.18f;
-        auto box = std::make_unique<box_t>(1);
-        auto node = std::make_unique<HNode>(std::move(box));
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, handH*0.5f, 0.0f));
-        node->scale     = glm::scale(glm::mat4(1.0f), glm::vec3(handWidth, handH, handDepth));
+        auto node = std::make_unique<HNode>();
+        node->translation = glm::vec3(0.0f, handH*0.5f, 0.0f);
+        node->scale     = glm::vec3(handWidth, handH, handDepth);
         node->color     = glm::vec4(0.3f, 1.0f, 0.4f, 1.0f); // brighter green
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
+        node->shape     = cache.box(1, glm::vec3(0.5f));
         handGeomPtr = node.get();
         handGeom = handGeomPtr;
-        hand->children.push_back(std::move(node));
+        hand->add_child(std::move(node));
     }
 
     // Grippers as children of hand geometry
@@ -136,24 +131,22 @@ void RobotArm::init() {
     gripperHeight = 0.30f;    
     const float gripYCenter = 0.5f * (handHeight + gripperHeight); // bottom flush with hand top
     {
-        auto box = std::make_unique<box_t>(0);
-        auto node = std::make_unique<HNode>(std::move(box));
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(-0.14f, gripYCenter, 0.0f));
-        node->scale     = glm::scale(glm::mat4(1.0f), glm::vec3(gripperWidth, gripperHeight, 0.07f));
+        auto node = std::make_unique<HNode>();
+        node->translation = glm::vec3(-0.14f, gripYCenter, 0.0f);
+        node->scale     = glm::vec3(gripperWidth, gripperHeight, 0.07f);
         node->color     = glm::vec4(1.0f, 0.7f, 0.2f, 1.0f); // brighter orange
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
+        node->shape     = cache.box(0, glm::vec3(0.5f));
         gripperLeft = node.get();
-        handGeomPtr->children.push_back(std::move(node));
+        handGeomPtr->add_child(std::move(node));
     }
     {
-        auto box = std::make_unique<box_t>(0);
-        auto node = std::make_unique<HNode>(std::move(box));
-        node->translate = glm::translate(glm::mat4(1.0f), glm::vec3(0.14f, gripYCenter, 0.0f));
-        node->scale     = glm::scale(glm::mat4(1.0f), glm::vec3(gripperWidth, gripperHeight, 0.07f));
+        auto node = std::make_unique<HNode>();
+        node->translation = glm::vec3(0.14f, gripYCenter, 0.0f);
+        node->scale     = glm::vec3(gripperWidth, gripperHeight, 0.07f);
         node->color     = glm::vec4(1.0f, 0.7f, 0.2f, 1.0f); // brighter orange
-        if(node->shape){ for(auto &c: node->shape->colors) c = node->color; glBindBuffer(GL_ARRAY_BUFFER, node->shape->vbo[1]); glBufferSubData(GL_ARRAY_BUFFER, 0, node->shape->colors.size()*sizeof(glm::vec4), node->shape->colors.data()); glBindBuffer(GL_ARRAY_BUFFER,0);} 
+        node->shape     = cache.box(0, glm::vec3(0.5f));
         gripperRight = node.get();
-        handGeomPtr->children.push_back(std::move(node));
+        handGeomPtr->add_child(std::move(node));
     }
 
     // Initial pose
@@ -177,21 +170,20 @@ void RobotArm::init() {
 // Recompute local rotation transforms from public angle fields and gripper open.
 void RobotArm::updateJoints() {
 
+    // Joints are only marked dirty when their rotation actually changes, so an
+    // unchanged pose leaves the cached world transforms untouched.
     // Update lower arm rotation (2 DOF)
-    lowerArm->rotate = glm::mat4(1.0f);
-    lowerArm->rotate = glm::rotate(lowerArm->rotate, lowerArmRotY, glm::vec3(0, 1, 0));
-    lowerArm->rotate = glm::rotate(lowerArm->rotate, lowerArmRotX, glm::vec3(1, 0, 0));
+    lowerArm->set_rotation(glm::angleAxis(lowerArmRotY, glm::vec3(0, 1, 0))
+                         * glm::angleAxis(lowerArmRotX, glm::vec3(1, 0, 0)));
     
     // Update upper arm rotation (2 DOF)
-    upperArm->rotate = glm::mat4(1.0f);
-    upperArm->rotate = glm::rotate(upperArm->rotate, upperArmRotY, glm::vec3(0, 1, 0));
-    upperArm->rotate = glm::rotate(upperArm->rotate, upperArmRotX, glm::vec3(1, 0, 0));
+    upperArm->set_rotation(glm::angleAxis(upperArmRotY, glm::vec3(0, 1, 0))
+                         * glm::angleAxis(upperArmRotX, glm::vec3(1, 0, 0)));
     
     // Update hand rotation (3 DOF)
-    hand->rotate = glm::mat4(1.0f);
-    hand->rotate = glm::rotate(hand->rotate, handRotZ, glm::vec3(0, 0, 1));
-    hand->rotate = glm::rotate(hand->rotate, handRotY, glm::vec3(0, 1, 0));
-    hand->rotate = glm::rotate(hand->rotate, handRotX, glm::vec3(1, 0, 0));
+    hand->set_rotation(glm::angleAxis(handRotZ, glm::vec3(0, 0, 1))
+                     * glm::angleAxis(handRotY, glm::vec3(0, 1, 0))
+                     * glm::angleAxis(handRotX, glm::vec3(1, 0, 0)));
     
 
     float t = gripperOpen;
@@ -206,12 +198,12 @@ void RobotArm::updateJoints() {
     const float offset       = (1.0f - t) * offsetClosed + t * offsetOpen;
 
     const float gripYCenter2 = 0.5f * (handHeight + gripperHeight);
-    gripperLeft->translate  = glm::translate(glm::mat4(1.0f), glm::vec3(-offset, gripYCenter2, 0.0f));
-    gripperRight->translate = glm::translate(glm::mat4(1.0f), glm::vec3( offset, gripYCenter2, 0.0f));
+    gripperLeft->set_translation(glm::vec3(-offset, gripYCenter2, 0.0f));
+    gripperRight->set_translation(glm::vec3( offset, gripYCenter2, 0.0f));
 }
 
-void RobotArm::draw(GLuint mvpLoc, GLuint modelLoc, const glm::mat4 &viewProj, GLint useTexLoc) {
-    model.draw(mvpLoc, modelLoc, viewProj, useTexLoc);
+void RobotArm::enqueue(render_queue_t &q, const glm::mat4 &viewProj) {
+    model.enqueue(q, viewProj);
 }
 
 
@@ -0,0 +1,192 @@
+// -----------------------------------------------------------------------------
+// shader_cache.cpp : Permutation source assembly, compilation, the program
+// binary cache and lookup.
+// Binary file: "PBIN", GLenum format, then the glGetProgramBinary blob. The
+// file name is the FNV-1a hash of both stage sources and the driver strings,
+// so edited shaders or a driver update simply miss and recompile.
+// -----------------------------------------------------------------------------
+#include "shader_cache.hpp"
+#include "frame_uniforms.hpp"
+#include "lights.hpp"
+#include "model.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sys/stat.h> // For mkdir
+
+shader_cache_t& shader_cache_t::instance(){
+    static shader_cache_t cache;
+    return cache;
+}
+
+// Utility: read entire file into string
+static std::string read_file(const std::string &path){
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f) return "";
+    fseek(f, 0, SEEK_END);
+    size_t sz = ftell(f);
+    rewind(f);
+    std::string s(sz, '\0');
+    if(fread(&s[0], 1, sz, f) != sz) s.clear();
+    fclose(f);
+    return s;
+}
+
+static uint64_t fnv1a(uint64_t h, const std::string &s){
+    for(unsigned char c : s){ h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+// Sources and driver identity, read once the context exists
+void shader_cache_t::init(){
+    const char* names[3] = { "/basic.vert", "/basic.frag", "/lighting.glsl" };
+    for(int i=0;i<3;i++){
+        sources[i] = read_file(dir + names[i]);
+        if(sources[i].empty()) std::cerr << "Failed to read shader: " << dir << names[i] << "\n";
+    }
+    for(GLenum e : { GL_VENDOR, GL_RENDERER, GL_VERSION }){
+        const GLubyte* s = glGetString(e);
+        driver += s ? (const char*)s : "";
+        driver += '\n';
+    }
+    GLint n = 0;
+    if(GLEW_ARB_get_program_binary && !binaryDir.empty()) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n);
+    formats.resize(n);
+    if(n > 0){
+        glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        mkdir(binaryDir.c_str(), 0755);
+    }
+}
+
+// #version line, permutation defines, lighting.glsl, rest of the stage
+// (#line keeps compiler messages pointing at the right file/line)
+std::string shader_cache_t::stage_source(GLenum type, const std::string &defines) const {
+    const std::string &body = sources[type == GL_VERTEX_SHADER ? 0 : 1];
+    size_t eol = body.find('\n');
+    std::string stage = (type == GL_VERTEX_SHADER) ? "1" : "2";
+    return body.substr(0, eol + 1) + defines + "#line 1 3\n" + sources[2] + "\n#line 2 " + stage + "\n" + body.substr(eol + 1);
+}
+
+std::string shader_cache_t::binary_path(uint64_t hash) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+    return binaryDir + name;
+}
+
+bool shader_cache_t::load_binary(GLuint program, uint64_t hash){
+    std::string blob = read_file(binary_path(hash));
+    if(blob.size() <= 4 + sizeof(GLenum) || blob.compare(0, 4, "PBIN") != 0) return false;
+    GLenum format;
+    memcpy(&format, &blob[4], sizeof(format));
+    if(std::find(formats.begin(), formats.end(), GLint(format)) == formats.end()) return false;
+    size_t header = 4 + sizeof(format);
+    glProgramBinary(program, format, blob.data() + header, GLsizei(blob.size() - header));
+    GLint ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    return ok != 0; // rejected (e.g. built by another driver version): relink from source
+}
+
+void shader_cache_t::save_binary(GLuint program, uint64_t hash){
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) return;
+    std::string blob(length, '\0');
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, &blob[0]);
+    FILE* f = fopen(binary_path(hash).c_str(), "wb");
+    if(!f) return;
+    fwrite("PBIN", 1, 4, f);
+    fwrite(&format, sizeof(format), 1, f);
+    fwrite(blob.data(), 1, size_t(length), f);
+    fclose(f);
+    saved++;
+}
+
+// Load the program from its binary, or issue its compile and link without
+// waiting for the result
+shader_cache_t::pending_t shader_cache_t::begin(uint32_t key){
+    if(sources[0].empty()) init();
+    std::string defines = "#define TEXTURED " + std::to_string((key & SHADER_TEXTURED) ? 1 : 0) + "\n"
+                        + "#define PER_PIXEL " + std::to_string((key & SHADER_PER_PIXEL) ? 1 : 0) + "\n"
+                        + "#define LIGHT_MODE " + std::to_string((key & SHADER_LIGHTS_MASK) >> 2) + "\n";
+    std::string vsrc = stage_source(GL_VERTEX_SHADER, defines), fsrc = stage_source(GL_FRAGMENT_SHADER, defines);
+    pending_t p{ key, glCreateProgram() };
+    p.hash = fnv1a(fnv1a(fnv1a(1469598103934665603ull, vsrc), fsrc), driver);
+    if(!formats.empty() && load_binary(p.program, p.hash)){ loaded++; return p; }
+
+    auto stage = [](GLenum type, const std::string &src){
+        const char* c = src.c_str();
+        GLuint sh = glCreateShader(type);
+        glShaderSource(sh, 1, &c, nullptr);
+        glCompileShader(sh);
+        return sh;
+    };
+    p.vs = stage(GL_VERTEX_SHADER, vsrc);
+    p.fs = stage(GL_FRAGMENT_SHADER, fsrc);
+    glAttachShader(p.program, p.vs); glAttachShader(p.program, p.fs);
+    if(!formats.empty()) glProgramParameteri(p.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(p.program);
+    compiled++;
+    return p;
+}
+
+// Wait for the link, report errors, store the binary and set the
+// per-program constants
+GLuint shader_cache_t::finish(const pending_t &p){
+    if(p.vs){
+        GLint ok; glGetProgramiv(p.program, GL_LINK_STATUS, &ok);
+        if(!ok){
+            char log[1024];
+            for(GLuint sh : { p.vs, p.fs }){
+                glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+                if(!ok){ glGetShaderInfoLog(sh, 1024, nullptr, log); std::cerr << log << std::endl; }
+            }
+            glGetProgramInfoLog(p.program, 1024, nullptr, log);
+            std::cerr << "Shader permutation " << p.key << ": " << log << std::endl;
+            exit(1);
+        }
+        glDetachShader(p.program, p.vs); glDetachShader(p.program, p.fs);
+        glDeleteShader(p.vs); glDeleteShader(p.fs);
+        if(!formats.empty()) save_binary(p.program, p.hash);
+    }
+    frame_uniforms_t::attach(p.program);
+    glUseProgram(p.program);
+    light_list_t::attach(p.program);
+    glUniform1i(glGetUniformLocation(p.program, "tex"), 0);
+    programs[p.key] = p.program;
+    return p.program;
+}
+
+GLuint shader_cache_t::program(uint32_t key){
+    auto it = programs.find(key);
+    if(it != programs.end()) return it->second;
+    auto t0 = std::chrono::steady_clock::now();
+    GLuint p = finish(begin(key));
+    compile_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    return p;
+}
+
+void shader_cache_t::preload(){
+    auto t0 = std::chrono::steady_clock::now();
+    if(GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu); // driver's choice
+    std::vector<pending_t> pending;
+    for(uint32_t key = 0; key < SHADER_PERMUTATIONS; key++)
+        if(!programs.count(key)) pending.push_back(begin(key));
+    for(const pending_t &p : pending) finish(p);
+    compile_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+uint32_t shader_cache_t::material_key(const HNode* material){
+    return (material->useTexture ? SHADER_TEXTURED : 0u) | (material->perPixel ? SHADER_PER_PIXEL : 0u);
+}
+
+void shader_cache_t::print_stats() const {
+    std::cout << "Shader cache: " << programs.size() << " programs (" << loaded << " from binaries, "
+              << compiled << " compiled, " << saved << " saved), " << compile_ms << " ms"
+              << (formats.empty() ? ", binary cache off" : "")
+              << (GLEW_KHR_parallel_shader_compile ? ", parallel compile" : "") << "\n";
+}
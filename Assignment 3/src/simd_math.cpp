@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------------
+// simd_math.cpp : Scalar / SSE / AVX2 matrix kernels and runtime dispatch.
+// glm::mat4 is 16 contiguous floats, column-major; no alignment is assumed.
+// -----------------------------------------------------------------------------
+#include "simd_math.hpp"
+#include <string>
+
+#if defined(__x86_64__)
+#define MAT_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#ifndef SIMD_KERNELS
+#define SIMD_KERNELS "auto"
+#endif
+
+// --- scalar (reference) -------------------------------------------------------
+static void mul_scalar(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out){ out = a * b; }
+static void propagate_scalar(const glm::mat4 &top, const int* parent, const glm::mat4* local, glm::mat4* world, const int* idx, size_t count){
+    for(size_t k = 0; k < count; k++){
+        int i = idx ? idx[k] : int(k), p = parent[i];
+        world[i] = (p < 0 ? top : world[p]) * local[i];
+    }
+}
+static void bounds_scalar(const glm::mat4* m, const aabb_t* box, aabb_t* out, const int* idx, size_t count){
+    for(size_t k = 0; k < count; k++){
+        size_t i = idx ? size_t(idx[k]) : k;
+        out[i] = box[i].transformed(m[i]);
+    }
+}
+
+#ifdef MAT_KERNELS_X86
+// --- SSE: one column per register -----------------------------------------------
+static inline __m128 col_sse(const __m128 a[4], const float *b){
+    __m128 r = _mm_mul_ps(a[0], _mm_set1_ps(b[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(a[1], _mm_set1_ps(b[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(a[2], _mm_set1_ps(b[2])));
+    return _mm_add_ps(r, _mm_mul_ps(a[3], _mm_set1_ps(b[3])));
+}
+static inline void mul_sse(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out){
+    const float *pa = &a[0][0], *pb = &b[0][0];
+    __m128 A[4] = { _mm_loadu_ps(pa), _mm_loadu_ps(pa+4), _mm_loadu_ps(pa+8), _mm_loadu_ps(pa+12) };
+    __m128 c0 = col_sse(A, pb), c1 = col_sse(A, pb+4), c2 = col_sse(A, pb+8), c3 = col_sse(A, pb+12);
+    float *po = &out[0][0];
+    _mm_storeu_ps(po, c0); _mm_storeu_ps(po+4, c1); _mm_storeu_ps(po+8, c2); _mm_storeu_ps(po+12, c3);
+}
+static void propagate_sse(const glm::mat4 &top, const int* parent, const glm::mat4* local, glm::mat4* world, const int* idx, size_t count){
+    for(size_t k = 0; k < count; k++){
+        int i = idx ? idx[k] : int(k), p = parent[i];
+        mul_sse(p < 0 ? top : world[p], local[i], world[i]);
+    }
+}
+// Box corners are not loaded as vectors (aabb_t is two packed vec3s); the
+// 3x4 transform and |M| * half run on whole columns.
+static void bounds_sse(const glm::mat4* m, const aabb_t* box, aabb_t* out, const int* idx, size_t count){
+    const __m128 half = _mm_set1_ps(0.5f), sign = _mm_set1_ps(-0.0f);
+    for(size_t k = 0; k < count; k++){
+        size_t i = idx ? size_t(idx[k]) : k;
+        const aabb_t &b = box[i];
+        if(b.empty()){ out[i] = aabb_t(); continue; }
+        __m128 lo = _mm_setr_ps(b.lo.x, b.lo.y, b.lo.z, 0.0f), hi = _mm_setr_ps(b.hi.x, b.hi.y, b.hi.z, 0.0f);
+        __m128 c = _mm_mul_ps(_mm_add_ps(lo, hi), half), h = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+        const float *pm = &m[i][0][0];
+        __m128 M0 = _mm_loadu_ps(pm), M1 = _mm_loadu_ps(pm+4), M2 = _mm_loadu_ps(pm+8), M3 = _mm_loadu_ps(pm+12);
+        __m128 wc = _mm_add_ps(M3, _mm_add_ps(_mm_mul_ps(M0, _mm_shuffle_ps(c, c, 0x00)),
+                               _mm_add_ps(_mm_mul_ps(M1, _mm_shuffle_ps(c, c, 0x55)), _mm_mul_ps(M2, _mm_shuffle_ps(c, c, 0xAA)))));
+        __m128 e = _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, M0), _mm_shuffle_ps(h, h, 0x00)),
+                   _mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, M1), _mm_shuffle_ps(h, h, 0x55)), _mm_mul_ps(_mm_andnot_ps(sign, M2), _mm_shuffle_ps(h, h, 0xAA))));
+        alignas(16) float l[4], u[4];
+        _mm_store_ps(l, _mm_sub_ps(wc, e)); _mm_store_ps(u, _mm_add_ps(wc, e));
+        out[i] = aabb_t(glm::vec3(l[0], l[1], l[2]), glm::vec3(u[0], u[1], u[2]));
+    }
+}
+
+// --- AVX2/FMA: two columns per register ------------------------------------------
+__attribute__((target("avx2,fma")))
+static inline __m256 col2_avx(const __m256 a[4], const float *b0, const float *b1){
+    __m256 r = _mm256_mul_ps(a[0], _mm256_set_m128(_mm_set1_ps(b1[0]), _mm_set1_ps(b0[0])));
+    r = _mm256_fmadd_ps(a[1], _mm256_set_m128(_mm_set1_ps(b1[1]), _mm_set1_ps(b0[1])), r);
+    r = _mm256_fmadd_ps(a[2], _mm256_set_m128(_mm_set1_ps(b1[2]), _mm_set1_ps(b0[2])), r);
+    return _mm256_fmadd_ps(a[3], _mm256_set_m128(_mm_set1_ps(b1[3]), _mm_set1_ps(b0[3])), r);
+}
+__attribute__((target("avx2,fma")))
+static inline void mul_avx2(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out){
+    const float *pa = &a[0][0], *pb = &b[0][0];
+    __m256 A[4] = { _mm256_broadcast_ps((const __m128*)pa), _mm256_broadcast_ps((const __m128*)(pa+4)),
+                    _mm256_broadcast_ps((const __m128*)(pa+8)), _mm256_broadcast_ps((const __m128*)(pa+12)) };
+    float *po = &out[0][0];
+    __m256 c01 = col2_avx(A, pb, pb+4), c23 = col2_avx(A, pb+8, pb+12);
+    _mm256_storeu_ps(po, c01); _mm256_storeu_ps(po+8, c23);
+}
+__attribute__((target("avx2,fma")))
+static void propagate_avx2(const glm::mat4 &top, const int* parent, const glm::mat4* local, glm::mat4* world, const int* idx, size_t count){
+    for(size_t k = 0; k < count; k++){
+        int i = idx ? idx[k] : int(k), p = parent[i];
+        mul_avx2(p < 0 ? top : world[p], local[i], world[i]);
+    }
+}
+__attribute__((target("avx2,fma")))
+static void bounds_avx2(const glm::mat4* m, const aabb_t* box, aabb_t* out, const int* idx, size_t count){
+    const __m128 half = _mm_set1_ps(0.5f), sign = _mm_set1_ps(-0.0f);
+    for(size_t k = 0; k < count; k++){
+        size_t i = idx ? size_t(idx[k]) : k;
+        const aabb_t &b = box[i];
+        if(b.empty()){ out[i] = aabb_t(); continue; }
+        __m128 lo = _mm_setr_ps(b.lo.x, b.lo.y, b.lo.z, 0.0f), hi = _mm_setr_ps(b.hi.x, b.hi.y, b.hi.z, 0.0f);
+        __m128 c = _mm_mul_ps(_mm_add_ps(lo, hi), half), h = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+        const float *pm = &m[i][0][0];
+        __m128 M0 = _mm_loadu_ps(pm), M1 = _mm_loadu_ps(pm+4), M2 = _mm_loadu_ps(pm+8), M3 = _mm_loadu_ps(pm+12);
+        __m128 wc = _mm_fmadd_ps(M2, _mm_permute_ps(c, 0xAA), _mm_fmadd_ps(M1, _mm_permute_ps(c, 0x55), _mm_fmadd_ps(M0, _mm_permute_ps(c, 0x00), M3)));
+        __m128 e = _mm_fmadd_ps(_mm_andnot_ps(sign, M2), _mm_permute_ps(h, 0xAA),
+                   _mm_fmadd_ps(_mm_andnot_ps(sign, M1), _mm_permute_ps(h, 0x55), _mm_mul_ps(_mm_andnot_ps(sign, M0), _mm_permute_ps(h, 0x00))));
+        alignas(16) float l[4], u[4];
+        _mm_store_ps(l, _mm_sub_ps(wc, e)); _mm_store_ps(u, _mm_add_ps(wc, e));
+        out[i] = aabb_t(glm::vec3(l[0], l[1], l[2]), glm::vec3(u[0], u[1], u[2]));
+    }
+}
+#endif
+
+const mat_kernels_t& mat_kernels_t::scalar(){
+    static const mat_kernels_t k{ "scalar", mul_scalar, propagate_scalar, bounds_scalar };
+    return k;
+}
+
+std::vector<const mat_kernels_t*> mat_kernels_t::supported(){
+    std::vector<const mat_kernels_t*> v{ &scalar() };
+#ifdef MAT_KERNELS_X86
+    static const mat_kernels_t sse{ "sse", mul_sse, propagate_sse, bounds_sse };
+    static const mat_kernels_t avx2{ "avx2", mul_avx2, propagate_avx2, bounds_avx2 };
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2")) v.push_back(&sse);
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) v.push_back(&avx2);
+#endif
+    return v;
+}
+
+// Best variant the CPU supports, capped by the SIMD_KERNELS build setting.
+static const mat_kernels_t& select_kernels(){
+    std::string want = SIMD_KERNELS;
+    const mat_kernels_t* best = &mat_kernels_t::scalar();
+    for(const mat_kernels_t* k : mat_kernels_t::supported()){
+        std::string name = k->name;
+        if(want == "scalar") break;
+        if(name == "avx2" && want != "auto" && want != "avx2") continue;
+        best = k;
+    }
+    return *best;
+}
+
+const mat_kernels_t& mat_kernels_t::active(){
+    static const mat_kernels_t& k = select_kernels();
+    return k;
+}
@@ -0,0 +1,49 @@
+// -----------------------------------------------------------------------------
+// stream_ring.cpp : Fenced round-robin streaming buffer.
+// -----------------------------------------------------------------------------
+#include "stream_ring.hpp"
+#include <algorithm>
+#include <cstring>
+
+void stream_ring_t::wait(int s){
+    if(!fences[s]) return;
+    // normally already signaled: rendering is at most a frame or two behind
+    while(glClientWaitSync(fences[s], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(fences[s]);
+    fences[s] = nullptr;
+}
+
+size_t stream_ring_t::write(const void* data, size_t bytes){
+    cur = (cur + 1) % SEGMENTS;
+    if(bytes > segment || !buf){
+        // grow geometrically; the old store may still be in flight
+        for(int s = 0; s < SEGMENTS; s++) wait(s);
+        segment = std::max(bytes, segment * 2);
+        segment = (segment + align - 1) / align * align;
+        if(!buf) glGenBuffers(1, &buf);
+        glBindBuffer(target, buf);
+        glBufferData(target, segment * SEGMENTS, nullptr, GL_STREAM_DRAW);
+        cur = 0;
+    } else {
+        wait(cur);
+        glBindBuffer(target, buf);
+    }
+    size_t offset = size_t(cur) * segment;
+    if(bytes){
+        void* dst = glMapBufferRange(target, offset, bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(dst){
+            std::memcpy(dst, data, bytes);
+            glUnmapBuffer(target);
+        } else {
+            glBufferSubData(target, offset, bytes, data);
+        }
+    }
+    glBindBuffer(target, 0);
+    return offset;
+}
+
+void stream_ring_t::fence(){
+    if(fences[cur]) glDeleteSync(fences[cur]);
+    fences[cur] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,192 @@
+// -----------------------------------------------------------------------------
+// vertex_arena.cpp : Shared geometry buffers, free-list sub-allocation and
+// multi-draw-indirect submission (with a per-command fallback).
+// -----------------------------------------------------------------------------
+#include "vertex_arena.hpp"
+#include "shape.hpp"
+#include <algorithm>
+#include <iostream>
+
+static const GLuint INITIAL_VERTICES = 1 << 16;
+static const GLuint INITIAL_INDICES = 1 << 18;
+
+vertex_arena_t& vertex_arena_t::instance(){
+    // never destroyed: shapes release their ranges from static destructors
+    static vertex_arena_t* arena = new vertex_arena_t(*shape_t::default_format);
+    return *arena;
+}
+
+vertex_arena_t::vertex_arena_t(const vertex_format_t &f): fmt(&f) {
+    // MDI reads baseInstance from the command only with ARB_base_instance (GL 4.2)
+    baseInstance = GLEW_ARB_base_instance;
+    useIndirect = GLEW_ARB_multi_draw_indirect && baseInstance;
+    glGenVertexArrays(1, &vao);
+    // one record so the per-draw buffer exists (and non-indirect draws never read past it)
+    instance_data_t first{ glm::mat4(1.0f), glm::vec4(1.0f), { glm::vec4(1,0,0,0), glm::vec4(0,1,0,0), glm::vec4(0,0,1,0) } };
+    records.write(&first, sizeof(first));
+    setup_vao();
+}
+
+// --- free list ------------------------------------------------------------------
+bool vertex_arena_t::free_list_t::take(GLuint n, GLuint &at){
+    for(auto it = spans.begin(); it != spans.end(); ++it){
+        if(it->second < n) continue;
+        at = it->first;
+        GLuint rest = it->second - n;
+        spans.erase(it);
+        if(rest) spans[at + n] = rest;
+        used += n;
+        return true;
+    }
+    return false;
+}
+void vertex_arena_t::free_list_t::give(GLuint at, GLuint n){
+    used -= n;
+    auto next = spans.lower_bound(at);
+    // merge with the following and preceding spans
+    if(next != spans.end() && at + n == next->first){ n += next->second; next = spans.erase(next); }
+    if(next != spans.begin()){
+        auto prev = std::prev(next);
+        if(prev->first + prev->second == at){ prev->second += n; return; }
+    }
+    spans[at] = n;
+}
+void vertex_arena_t::free_list_t::extend(GLuint newCapacity){
+    GLuint old = capacity;
+    capacity = newCapacity;
+    used += newCapacity - old; // give() subtracts it again
+    give(old, newCapacity - old);
+}
+
+// --- buffers --------------------------------------------------------------------
+// Reallocate a backing buffer at least twice as large and copy the old contents
+void vertex_arena_t::grow(GLuint &buffer, GLenum target, free_list_t &list, GLuint need, size_t elemBytes){
+    GLuint cap = std::max({ list.capacity * 2, list.capacity + need, target == GL_ARRAY_BUFFER ? INITIAL_VERTICES : INITIAL_INDICES });
+    GLuint fresh = 0;
+    glGenBuffers(1, &fresh);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, fresh);
+    glBufferData(GL_COPY_WRITE_BUFFER, cap * elemBytes, nullptr, GL_STATIC_DRAW);
+    if(buffer){
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, list.capacity * elemBytes);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = fresh;
+    list.extend(cap);
+    setup_vao();
+}
+
+// Vertex attributes over vbo/ebo plus the per-draw attributes over the record ring
+void vertex_arena_t::setup_vao(){
+    glBindVertexArray(vao);
+    if(vbo){
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        fmt->apply();
+    }
+    if(ebo) glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBindBuffer(GL_ARRAY_BUFFER, records.buffer());
+    for(GLuint c=0;c<8;c++){
+        glEnableVertexAttribArray(4+c);
+        glVertexAttribDivisor(4+c, 1);
+    }
+    point_instances(0);
+    glBindVertexArray(0);
+}
+
+// Point the per-draw attributes at record `first` (records bound, arena VAO bound)
+void vertex_arena_t::point_instances(GLuint first) const {
+    size_t base = size_t(first) * sizeof(instance_data_t);
+    for(GLuint c=0;c<4;c++)
+        glVertexAttribPointer(4+c, 4, GL_FLOAT, GL_FALSE, sizeof(instance_data_t), (void*)(base + sizeof(glm::vec4)*c));
+    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(instance_data_t), (void*)(base + sizeof(glm::mat4)));
+    for(GLuint c=0;c<3;c++)
+        glVertexAttribPointer(9+c, 3, GL_FLOAT, GL_FALSE, sizeof(instance_data_t), (void*)(base + sizeof(glm::mat4) + sizeof(glm::vec4)*(1+c)));
+}
+
+void vertex_arena_t::reserve(GLuint vertexCount, GLuint indexCount){
+    if(vertices.capacity - vertices.used < vertexCount) grow(vbo, GL_ARRAY_BUFFER, vertices, vertexCount, fmt->stride);
+    if(indices.capacity - indices.used < indexCount) grow(ebo, GL_ELEMENT_ARRAY_BUFFER, indices, indexCount, sizeof(GLuint));
+}
+
+arena_range_t vertex_arena_t::alloc(const std::vector<unsigned char> &packed, GLuint vertexCount, const std::vector<GLuint> &idx){
+    arena_range_t r;
+    GLuint at = 0;
+    if(!vertices.take(vertexCount, at)){
+        grow(vbo, GL_ARRAY_BUFFER, vertices, vertexCount, fmt->stride);
+        vertices.take(vertexCount, at);
+    }
+    r.base_vertex = GLint(at);
+    r.vertex_count = vertexCount;
+    if(!indices.take(GLuint(idx.size()), at)){
+        grow(ebo, GL_ELEMENT_ARRAY_BUFFER, indices, GLuint(idx.size()), sizeof(GLuint));
+        indices.take(GLuint(idx.size()), at);
+    }
+    r.first_index = at;
+    r.index_count = GLuint(idx.size());
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, size_t(r.base_vertex) * fmt->stride, packed.size(), packed.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // element buffer binding is VAO state; upload through the copy target instead
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, size_t(r.first_index) * sizeof(GLuint), idx.size() * sizeof(GLuint), idx.data());
+    ranges++;
+    return r;
+}
+
+void vertex_arena_t::release(const arena_range_t &r){
+    if(r.index_count == 0) return;
+    vertices.give(GLuint(r.base_vertex), r.vertex_count);
+    indices.give(r.first_index, r.index_count);
+    ranges--;
+}
+
+// --- submission -----------------------------------------------------------------
+GLuint vertex_arena_t::upload_instances(const instance_data_t* inst, size_t n){
+    return GLuint(records.write(inst, n * sizeof(instance_data_t)) / sizeof(instance_data_t));
+}
+
+void vertex_arena_t::upload_commands(const draw_elements_indirect_t* cmds, size_t n){
+    commands.assign(cmds, cmds + n);
+    if(!useIndirect || n == 0) return;
+    cmdOffset = indirectCmds.write(cmds, n * sizeof(draw_elements_indirect_t));
+}
+
+void vertex_arena_t::end_submit(){
+    records.fence();
+    if(useIndirect) indirectCmds.fence();
+}
+
+size_t vertex_arena_t::multi_draw(size_t first, size_t n){
+    if(n == 0) return 0;
+    glBindVertexArray(vao);
+    size_t calls = 0;
+    if(useIndirect){
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectCmds.buffer());
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(cmdOffset + first * sizeof(draw_elements_indirect_t)), GLsizei(n), 0);
+        calls = 1;
+    } else {
+        // one call per command; without base instance re-point the per-draw attributes
+        if(!baseInstance) glBindBuffer(GL_ARRAY_BUFFER, records.buffer());
+        for(size_t k = first; k < first + n; k++){
+            const draw_elements_indirect_t &c = commands[k];
+            void* offset = (void*)(size_t(c.firstIndex) * sizeof(GLuint));
+            if(baseInstance){
+                glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, c.count, GL_UNSIGNED_INT, offset, c.instanceCount, c.baseVertex, c.baseInstance);
+            } else {
+                point_instances(c.baseInstance);
+                glDrawElementsInstancedBaseVertex(GL_TRIANGLES, c.count, GL_UNSIGNED_INT, offset, c.instanceCount, c.baseVertex);
+            }
+            calls++;
+        }
+        if(!baseInstance) point_instances(0);
+    }
+    glBindVertexArray(0);
+    return calls;
+}
+
+void vertex_arena_t::print_stats() const {
+    std::cout << "Vertex arena: " << ranges << " meshes, "
+              << vertices.used << "/" << vertices.capacity << " vertices, "
+              << indices.used << "/" << indices.capacity << " indices in use"
+              << (useIndirect ? " (multi-draw indirect)\n" : " (per-command fallback)\n");
+}